@@ -0,0 +1,239 @@
+#include "analysiscache.h"
+#include "instrumentation.h"
+
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+/*
+ *  File layout
+ */
+
+static const char CACHE_MAGIC[8] = { 'C', 'H', 'S', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t CACHE_VERSION = 1;
+
+struct AnalysisCache::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t buckets;
+    uint64_t clock;                     //stores ever made, updated atomically by all processes
+    char reserved[32];
+};
+
+struct AnalysisCache::Slot
+{
+    uint64_t hash;                      //0 - empty
+    uint32_t checksum;                  //of everything else
+    uint32_t age;                       //header clock of the last write
+    int16_t score;
+    uint8_t depth;
+    uint8_t pv_length;
+    PackedMove pv[MAX_PV];
+};
+
+static_assert(sizeof(PackedMove) == 2, "cache slot layout");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "header clock is shared between processes");
+
+static const size_t HEADER_SIZE = 64;
+static const size_t SLOT_SIZE = 64;
+static const size_t CHECKSUM_END = 12;          //hash & checksum fields
+
+// FNV-1a over the hash & the payload
+static uint32_t checksum(const char* slot)
+{
+    uint32_t res = 2166136261u;
+    for(size_t i=0; i<SLOT_SIZE; i++) {
+        if( i >= 8 && i < CHECKSUM_END ) {
+            continue;
+        }
+        res = (res ^ static_cast<unsigned char>(slot[i])) * 16777619u;
+    }
+    return res;
+}
+
+//a cache or a new file: empty or with a zero header (creation never got to the magic)
+static bool is_cache_file(const std::string& path)
+{
+    struct stat st;
+    if( stat(path.c_str(), &st) != 0 || st.st_size == 0 ) {
+        return true;
+    }
+    MappedFile file;
+    if( !file.open(path) ) {
+        return false;
+    }
+    const size_t size = std::min(file.size(), HEADER_SIZE);
+    if( size >= sizeof(CACHE_MAGIC) && memcmp(file.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 ) {
+        return true;
+    }
+    return std::all_of(file.data(), file.data() + size, [](char ch) { return ch == 0; });
+}
+
+/*
+ *  AnalysisCache implementation
+ */
+
+AnalysisCache::AnalysisCache():
+    m_header(NULL), m_slots(NULL), m_buckets(0)
+{
+    static_assert(sizeof(Header) == HEADER_SIZE, "cache header layout");
+    static_assert(sizeof(Slot) == SLOT_SIZE, "cache slot layout");
+}
+
+AnalysisCache::~AnalysisCache()
+{
+    close();
+}
+
+bool AnalysisCache::open(const std::string& path, size_t size_mb)
+{
+    close();
+
+    const size_t bucket_size = SLOT_SIZE * BUCKET_SLOTS;
+    uint64_t buckets = 1;
+    while( buckets * 2 * bucket_size <= (size_mb << 20) ) {
+        buckets *= 2;
+    }
+    // anything else is refused rather than extended & overwritten, e.g. a games file given by mistake
+    if( path.empty() || !is_cache_file(path) || !m_file.open_writable(path, HEADER_SIZE + buckets * bucket_size) ) {
+        return false;
+    }
+
+    Header* header = reinterpret_cast<Header*>(m_file.writable_data());
+    bool has_magic = memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0;
+    bool valid = has_magic && header->version == CACHE_VERSION && header->slot_size == SLOT_SIZE &&
+                 header->buckets != 0 && (header->buckets & (header->buckets - 1)) == 0 &&
+                 HEADER_SIZE + header->buckets * bucket_size <= m_file.size();
+    if( !valid ) {
+        buckets = 1;
+        while( HEADER_SIZE + buckets * 2 * bucket_size <= m_file.size() ) {
+            buckets *= 2;
+        }
+        // a new file is all zeros & stays sparse, an older format is dropped
+        if( has_magic ) {
+            memset(m_file.writable_data(), 0, HEADER_SIZE + buckets * bucket_size);
+        }
+        header->version = CACHE_VERSION;
+        header->slot_size = SLOT_SIZE;
+        header->buckets = buckets;
+        header->clock = 0;
+        // magic goes last, a crash before it makes the next open start over
+        memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    }
+
+    m_header = header;
+    m_slots = reinterpret_cast<Slot*>(m_file.writable_data() + HEADER_SIZE);
+    m_buckets = header->buckets;
+    return true;
+}
+
+void AnalysisCache::close()
+{
+    if( is_open() ) {
+        m_file.flush();
+    }
+    m_file.close();
+    m_header = NULL;
+    m_slots = NULL;
+    m_buckets = 0;
+}
+
+AnalysisCache::Slot* AnalysisCache::bucket(uint64_t hash) const
+{
+    return m_slots + (hash & (m_buckets - 1)) * BUCKET_SLOTS;
+}
+
+std::mutex& AnalysisCache::bucket_mutex(uint64_t hash) const
+{
+    return m_mutexes[(hash & (m_buckets - 1)) % MUTEX_STRIPES];
+}
+
+bool AnalysisCache::lookup(uint64_t hash, SearchResult& result) const
+{
+    if( !is_open() || hash == 0 ) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(bucket_mutex(hash));
+    const Slot* slots = bucket(hash);
+    for(int i=0; i<BUCKET_SLOTS; i++) {
+        // copy first: another process may be writing the slot right now
+        Slot slot;
+        memcpy(&slot, &slots[i], sizeof(Slot));
+        if( slot.hash != hash || slot.checksum != checksum(reinterpret_cast<const char*>(&slot)) ||
+                slot.pv_length == 0 || slot.pv_length > MAX_PV ) {
+            continue;
+        }
+        result = SearchResult();
+        result.valid = true;
+        result.score = slot.score;
+        result.depth = slot.depth;
+        result.pv.assign(slot.pv, slot.pv + slot.pv_length);
+        result.best_move = result.pv.front();
+        PvLine line = { result.score, result.pv };
+        result.lines.push_back(line);
+        PROBE_COUNT(Probe::CACHE_HIT, 1);
+        return true;
+    }
+    return false;
+}
+
+void AnalysisCache::store(uint64_t hash, const SearchResult& result)
+{
+    if( !is_open() || hash == 0 || !result.valid || result.depth <= 0 || result.pv.empty() ) {
+        return;
+    }
+    std::atomic<uint64_t>* clock = reinterpret_cast<std::atomic<uint64_t>*>(&m_header->clock);
+    const uint32_t now = static_cast<uint32_t>(clock->fetch_add(1, std::memory_order_relaxed));
+
+    std::lock_guard<std::mutex> lock(bucket_mutex(hash));
+    Slot* slots = bucket(hash);
+    Slot* victim = NULL;
+    uint32_t victim_age = 0;
+    for(int i=0; i<BUCKET_SLOTS; i++) {
+        Slot slot;
+        memcpy(&slot, &slots[i], sizeof(Slot));
+        bool valid = slot.hash != 0 && slot.checksum == checksum(reinterpret_cast<const char*>(&slot));
+        if( valid && slot.hash == hash ) {
+            if( slot.depth > result.depth ) {
+                return;
+            }
+            victim = &slots[i];
+            break;
+        }
+        // empty & broken slots go first, then the one written longest ago
+        uint32_t age = valid ? now - slot.age : UINT32_MAX;
+        if( !victim || age > victim_age ) {
+            victim = &slots[i];
+            victim_age = age;
+        }
+    }
+
+    Slot slot;
+    memset(&slot, 0, sizeof(Slot));
+    slot.hash = hash;
+    slot.age = now;
+    slot.score = static_cast<int16_t>(std::max(-MATE_SCORE, std::min(MATE_SCORE, result.score)));
+    slot.depth = static_cast<uint8_t>(std::min(result.depth, 255));
+    slot.pv_length = static_cast<uint8_t>(std::min<size_t>(result.pv.size(), MAX_PV));
+    std::copy(result.pv.begin(), result.pv.begin() + slot.pv_length, slot.pv);
+    slot.checksum = checksum(reinterpret_cast<const char*>(&slot));
+    memcpy(victim, &slot, sizeof(Slot));
+}
+
+std::string AnalysisCache::default_path()
+{
+    const char* path = getenv("CHESS_ANALYSIS_CACHE");
+    if( path && *path ) {
+        return path;
+    }
+    const char* home = getenv("HOME");
+    if( !home || !*home ) {
+        return std::string();
+    }
+    return std::string(home) + "/.chess_analysis.cache";
+}
@@ -0,0 +1,63 @@
+#ifndef ANALYSISCACHE_H
+#define ANALYSISCACHE_H
+
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+#include "mappedfile.h"
+#include "search.h"
+
+/*
+ *  AnalysisCache - search results by position hash kept in a memory-mapped file between runs.
+ *
+ *  The file is a fixed size hash table of buckets with BUCKET_SLOTS entries each,
+ *  it is mapped and never read as a whole: only pages of the looked up buckets are touched.
+ *  Every entry carries a checksum, an entry torn by a crash or by a concurrent writer
+ *  of another process reads as empty. A full bucket drops its least recently written entry.
+ */
+
+class AnalysisCache
+{
+public:
+    static const size_t DEFAULT_SIZE_MB = 64;
+    static const int BUCKET_SLOTS = 4;
+    //longer variations are truncated
+    static const int MAX_PV = 22;
+
+    AnalysisCache();
+    ~AnalysisCache();
+
+    //creates the file if missing, size_mb only applies to a new cache
+    //refuses existing files that are not caches instead of overwriting them
+    bool open(const std::string& path, size_t size_mb = DEFAULT_SIZE_MB);
+    void close();
+    bool is_open() const                                {   return m_buckets != 0;   }
+
+    //thread safe, fills score, depth, best move, pv & a single line, nodes is 0
+    bool lookup(uint64_t hash, SearchResult& result) const;
+    //thread safe, a shallower result never replaces a deeper one of the same position
+    void store(uint64_t hash, const SearchResult& result);
+    bool flush()                                        {   return m_file.flush();   }
+
+    size_t capacity() const                             {   return m_buckets * BUCKET_SLOTS;   }
+
+    //$CHESS_ANALYSIS_CACHE or ~/.chess_analysis.cache, shared by the GUI & the tools
+    static std::string default_path();
+private:
+    struct Header;
+    struct Slot;
+
+    Slot* bucket(uint64_t hash) const;
+    std::mutex& bucket_mutex(uint64_t hash) const;
+
+    MappedFile m_file;
+    Header* m_header;
+    Slot* m_slots;
+    uint64_t m_buckets;                 //power of 2
+    //serializes threads of this process, other processes are caught by checksums
+    static const int MUTEX_STRIPES = 64;
+    mutable std::mutex m_mutexes[MUTEX_STRIPES];
+};
+
+#endif // ANALYSISCACHE_H
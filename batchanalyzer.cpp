@@ -0,0 +1,121 @@
+#include "batchanalyzer.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+
+/*
+ *  BatchAnalyzer implementation
+ */
+
+BatchAnalyzer::BatchAnalyzer(int threads, size_t hash_mb):
+    m_tt(hash_mb), m_cache_hits(0), m_pool(threads)
+{
+    for(int i=0; i<m_pool.threads_count(); i++) {
+        m_searchers.push_back(std::unique_ptr<Searcher>(new Searcher(m_tt)));
+    }
+}
+
+size_t BatchAnalyzer::analyze(std::istream& fens, const SearchLimits& limits, const ResultCallback& callback)
+{
+    return analyze([&fens](std::string& fen) {
+        while( std::getline(fens, fen) ) {
+            if( fen.find_first_not_of(" \t\r") != std::string::npos ) {
+                return true;
+            }
+        }
+        return false;
+    }, limits, callback);
+}
+
+std::vector<SearchResult> BatchAnalyzer::analyze(const std::vector<std::string>& fens, const SearchLimits& limits)
+{
+    std::vector<SearchResult> results;
+    results.reserve(fens.size());
+    size_t next = 0;
+    analyze([&fens, &next](std::string& fen) {
+        if( next == fens.size() ) {
+            return false;
+        }
+        fen = fens[next++];
+        return true;
+    }, limits, [&results](size_t, const std::string&, const SearchResult& result) {
+        results.push_back(result);
+    });
+    return results;
+}
+
+size_t BatchAnalyzer::analyze(const FenSource& next, const SearchLimits& limits, const ResultCallback& callback)
+{
+    struct Slot
+    {
+        std::string fen;
+        SearchResult result;
+        bool done;
+    };
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Slot> slots;         //in flight & not yet reported, slots[0] has index first
+    size_t first = 0;
+
+    // reports the finished prefix, waits while more than max_in_flight positions are pending
+    auto report = [&](size_t max_in_flight) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while( !slots.empty() ) {
+            if( !slots.front().done ) {
+                if( slots.size() <= max_in_flight ) {
+                    break;
+                }
+                cv.wait(lock, [&slots]() { return slots.front().done; });
+            }
+            Slot slot = std::move(slots.front());
+            slots.pop_front();
+            size_t ind = first++;
+            lock.unlock();
+            callback(ind, slot.fen, slot.result);
+            lock.lock();
+        }
+    };
+
+    m_tt.new_search();
+    m_cache_hits.store(0);
+    // a cached line is only as good as a search limited by depth with a single pv
+    const bool use_cached = m_cache && limits.nodes == 0 && limits.multi_pv <= 1;
+    const size_t window = WINDOW_PER_THREAD * m_pool.threads_count();
+    std::string fen;
+    while( next(fen) ) {
+        size_t ind;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Slot slot = { fen, SearchResult(), false };
+            slots.push_back(std::move(slot));
+            ind = first + slots.size() - 1;
+        }
+        m_pool.submit([this, fen, ind, use_cached, &limits, &mutex, &cv, &slots, &first]() {
+            SearchResult result;
+            Position pos;
+            if( pos.set_fen(fen) ) {
+                // a found mate ends the search before the depth limit
+                if( use_cached && m_cache->lookup(pos.get_hash(), result) &&
+                        (result.depth >= limits.depth || std::abs(result.score) > MATE_BOUND) ) {
+                    m_cache_hits++;
+                } else {
+                    result = m_searchers[ThreadPool::worker_index()]->search(pos, limits);
+                    if( m_cache ) {
+                        m_cache->store(pos.get_hash(), result);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            Slot& slot = slots[ind - first];
+            slot.result = std::move(result);
+            slot.done = true;
+            // under the lock: analyze() may return as soon as it sees the last result
+            cv.notify_all();
+        });
+        report(window);
+    }
+    report(0);
+    return first;
+}
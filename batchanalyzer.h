@@ -0,0 +1,57 @@
+#ifndef BATCHANALYZER_H
+#define BATCHANALYZER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <istream>
+#include <functional>
+#include <atomic>
+
+#include "search.h"
+#include "threadpool.h"
+#include "analysiscache.h"
+
+/*
+ *  BatchAnalyzer - searches lots of FEN positions on a thread pool.
+ *  Every worker has its own Searcher (board & search stacks), the transposition table is shared.
+ *  Results are handed out in input order as soon as the prefix is complete,
+ *  positions in flight are bounded, so a stream of any length runs in constant memory.
+ *  With a cache attached, positions searched deep enough before are not searched again.
+ */
+
+class BatchAnalyzer
+{
+public:
+    //called from the thread which runs analyze(), in input order
+    typedef std::function<void(size_t index, const std::string& fen, const SearchResult& result)> ResultCallback;
+    //gives the next FEN to search, called from the thread which runs analyze(), false at the end of input
+    typedef std::function<bool(std::string& fen)> FenSource;
+
+    BatchAnalyzer(int threads, size_t hash_mb);
+
+    //one FEN per line, empty lines are skipped, @ret positions count
+    size_t analyze(std::istream& fens, const SearchLimits& limits, const ResultCallback& callback);
+    std::vector<SearchResult> analyze(const std::vector<std::string>& fens, const SearchLimits& limits);
+    //FENs made on the fly, at most WINDOW_PER_THREAD per worker are taken ahead of the reported ones
+    size_t analyze(const FenSource& next, const SearchLimits& limits, const ResultCallback& callback);
+
+    int threads_count() const                           {   return m_pool.threads_count();   }
+    void clear_hash()                                   {   m_tt.clear();   }
+
+    //results are looked up before & stored after every search, an empty pointer detaches
+    void set_cache(const std::shared_ptr<AnalysisCache>& cache)     {   m_cache = cache;   }
+    //positions answered by the cache during the last analyze()
+    size_t cache_hits() const                           {   return m_cache_hits.load();   }
+
+    //positions in flight per worker
+    static const size_t WINDOW_PER_THREAD = 32;
+private:
+    TranspositionTable m_tt;
+    std::shared_ptr<AnalysisCache> m_cache;
+    std::atomic<size_t> m_cache_hits;
+    std::vector<std::unique_ptr<Searcher> > m_searchers;
+    ThreadPool m_pool;
+};
+
+#endif // BATCHANALYZER_H
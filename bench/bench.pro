@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    board \
+    board_view \
+    search \
+    game_manager
@@ -0,0 +1,157 @@
+#include "benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/*
+ *  Allocation counting
+ */
+
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    void* ptr = std::malloc(size ? size : 1);
+    if( !ptr ) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+uint64_t allocation_count()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+/*
+ *  BenchmarkResult implementation
+ */
+
+double BenchmarkResult::percentile(double p) const
+{
+    if( samples.empty() ) {
+        return 0;
+    }
+    double pos = p / 100.0 * (samples.size() - 1);
+    size_t ind = static_cast<size_t>(pos);
+    if( ind + 1 >= samples.size() ) {
+        return samples.back();
+    }
+    return samples[ind] + (pos - ind) * (samples[ind+1] - samples[ind]);
+}
+
+double BenchmarkResult::mean() const
+{
+    double sum = 0;
+    for(auto iter=samples.begin(); iter!=samples.end(); iter++) {
+        sum += *iter;
+    }
+    return samples.empty() ? 0 : sum / samples.size();
+}
+
+/*
+ *  BenchmarkRunner implementation
+ *  options: --warmup N, --reps N, --filter substring, --json file
+ */
+
+BenchmarkRunner::BenchmarkRunner(int argc, char* argv[]):
+    m_warmup(3), m_repetitions(30)
+{
+    for(int i=1; i+1<argc; i+=2) {
+        if( !strcmp(argv[i], "--warmup") ) {
+            m_warmup = std::atoi(argv[i+1]);
+        } else if( !strcmp(argv[i], "--reps") ) {
+            m_repetitions = std::max(1, std::atoi(argv[i+1]));
+        } else if( !strcmp(argv[i], "--filter") ) {
+            m_filter = argv[i+1];
+        } else if( !strcmp(argv[i], "--json") ) {
+            m_json_file = argv[i+1];
+        }
+    }
+}
+
+void BenchmarkRunner::run(const std::string& name, size_t ops, Body body, Setup setup)
+{
+    if( !m_filter.empty() && name.find(m_filter) == std::string::npos ) {
+        return;
+    }
+    typedef std::chrono::steady_clock Clock;
+
+    BenchmarkResult result;
+    result.name = name;
+    result.ops = ops;
+
+    uint64_t allocations = 0;
+    for(int rep=-m_warmup; rep<m_repetitions; rep++) {
+        if( setup ) {
+            setup();
+        }
+        uint64_t allocs_before = allocation_count();
+        Clock::time_point start = Clock::now();
+        body(ops);
+        Clock::time_point end = Clock::now();
+        if( rep >= 0 ) {
+            allocations += allocation_count() - allocs_before;
+            result.samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / ops);
+        }
+    }
+    std::sort(result.samples.begin(), result.samples.end());
+    result.allocations = static_cast<double>(allocations) / (static_cast<double>(ops) * m_repetitions);
+    m_results.push_back(result);
+}
+
+bool BenchmarkRunner::report() const
+{
+    std::cout << std::left << std::setw(40) << "benchmark" << std::right
+              << std::setw(12) << "median ns" << std::setw(12) << "p10" << std::setw(12) << "p90"
+              << std::setw(12) << "p99" << std::setw(12) << "allocs/op" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for(auto iter=m_results.begin(); iter!=m_results.end(); iter++) {
+        std::cout << std::left << std::setw(40) << iter->name << std::right
+                  << std::setw(12) << iter->percentile(50) << std::setw(12) << iter->percentile(10)
+                  << std::setw(12) << iter->percentile(90) << std::setw(12) << iter->percentile(99)
+                  << std::setw(12) << iter->allocations << std::endl;
+    }
+    return m_json_file.empty() || write_json(m_json_file);
+}
+
+bool BenchmarkRunner::write_json(const std::string& file) const
+{
+    std::ofstream out(file.c_str());
+    if( !out ) {
+        return false;
+    }
+    out << std::setprecision(6);
+    out << "{\n  \"warmup\": " << m_warmup << ",\n  \"repetitions\": " << m_repetitions
+        << ",\n  \"benchmarks\": [\n";
+    for(size_t i=0; i<m_results.size(); i++) {
+        const BenchmarkResult& r = m_results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops
+            << ", \"unit\": \"ns/op\", \"median\": " << r.percentile(50)
+            << ", \"mean\": " << r.mean()
+            << ", \"min\": " << r.samples.front() << ", \"max\": " << r.samples.back()
+            << ", \"p10\": " << r.percentile(10) << ", \"p90\": " << r.percentile(90)
+            << ", \"p99\": " << r.percentile(99)
+            << ", \"allocations_per_op\": " << r.allocations << "}"
+            << (i+1 < m_results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return out.good();
+}
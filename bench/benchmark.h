@@ -0,0 +1,55 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+/*
+ *  Minimal benchmark harness: warmup, repetitions, percentiles,
+ *  heap allocations per operation & JSON report.
+ *
+ *  Every repetition calls body(ops) once and is timed as a whole,
+ *  body must perform ops operations; setup runs before every repetition untimed.
+ */
+
+//number of operator new calls in the process so far
+uint64_t allocation_count();
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t ops;
+    //nanoseconds per operation, sorted
+    std::vector<double> samples;
+    double allocations;     //per operation
+
+    double percentile(double p) const;
+    double mean() const;
+};
+
+class BenchmarkRunner
+{
+public:
+    typedef std::function<void()> Setup;
+    typedef std::function<void(size_t ops)> Body;
+
+    BenchmarkRunner(int argc, char* argv[]);
+
+    void run(const std::string& name, size_t ops, Body body, Setup setup = Setup());
+
+    //prints table & writes json if --json was given
+    bool report() const;
+private:
+    bool write_json(const std::string& file) const;
+
+    int m_warmup;
+    int m_repetitions;
+    std::string m_filter;
+    std::string m_json_file;
+    std::vector<BenchmarkResult> m_results;
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,46 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+QT = core
+
+QMAKE_CXXFLAGS += -std=c++11 -O2
+LIBS += -pthread
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../benchmark.cpp \
+    ../../chessfieldmodel.cpp \
+    ../../chessboard.cpp \
+    ../../chesspiecemove.cpp \
+    ../../zobrist.cpp \
+    ../../positionindex.cpp \
+    ../../mappedfile.cpp \
+    ../../gamejournal.cpp \
+    ../../position.cpp \
+    ../../search.cpp \
+    ../../pawntable.cpp \
+    ../../timemanager.cpp \
+    ../../analysiscache.cpp \
+    ../../preanalyzer.cpp \
+    ../../engineplayer.cpp
+
+HEADERS += \
+    ../benchmark.h \
+    ../../chessfieldmodel.h \
+    ../../chessboard.h \
+    ../../chesspiecemove.h \
+    ../../zobrist.h \
+    ../../positionindex.h \
+    ../../mappedfile.h \
+    ../../gamejournal.h \
+    ../../position.h \
+    ../../search.h \
+    ../../pawntable.h \
+    ../../timemanager.h \
+    ../../analysiscache.h \
+    ../../preanalyzer.h \
+    ../../engineplayer.h
+
+include(../../instrumentation.pri)
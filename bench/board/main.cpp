@@ -0,0 +1,114 @@
+#include <sstream>
+#include <string>
+#include <iostream>
+
+#include "../benchmark.h"
+#include "chessboard.h"
+#include "chessfieldmodel.h"
+
+/*
+ *  board [--warmup N] [--reps N] [--filter name] [--json file]
+ *
+ *  Hot paths of ChessBoard & ChessFieldModel.
+ */
+
+static void load(ChessBoard& board, const std::string& moves)
+{
+    std::istringstream in(moves);
+    if( !board.load_game(in) ) {
+        std::cerr << "bad benchmark game: " << moves << std::endl;
+        std::exit(1);
+    }
+}
+
+//knights going back and forth, plies count is 4*cycles
+static std::string long_game(int cycles)
+{
+    std::string game;
+    for(int i=0; i<cycles; i++) {
+        game += "[g1,f3] [g8,f6] [f3,g1] [f6,g8] ";
+    }
+    return game;
+}
+
+struct PieceMove
+{
+    const char* name;
+    const char* prefix;
+    vec2 src;
+    vec2 dst;
+};
+
+static const PieceMove PIECE_MOVES[] = {
+    { "pawn",     "",                                               vec2(1,4), vec2(3,4) },
+    { "knight",   "",                                               vec2(0,6), vec2(2,5) },
+    { "bishop",   "[e2,e4] [e7,e5]",                                vec2(0,5), vec2(3,2) },
+    { "castle",   "[a2,a4] [a7,a5]",                                vec2(0,0), vec2(2,0) },
+    { "queen",    "[e2,e4] [e7,e5]",                                vec2(0,3), vec2(4,7) },
+    { "king",     "[e2,e4] [e7,e5]",                                vec2(0,4), vec2(1,4) },
+    { "castling", "[e2,e4] [e7,e5] [g1,f3] [b8,c6] [f1,c4] [f8,c5]", vec2(0,4), vec2(0,7) }
+};
+
+int main(int argc, char *argv[])
+{
+    BenchmarkRunner runner(argc, argv);
+    const size_t OPS = 10000;
+
+    for(size_t i=0; i<sizeof(PIECE_MOVES)/sizeof(PIECE_MOVES[0]); i++) {
+        const PieceMove& pm = PIECE_MOVES[i];
+        ChessBoard board;
+        load(board, pm.prefix);
+        runner.run(std::string("make_move+undo/") + pm.name, OPS, [&](size_t ops) {
+            for(size_t op=0; op<ops; op++) {
+                board.make_move(pm.src, pm.dst);
+                board.undo();
+            }
+        });
+    }
+
+    {
+        ChessBoard board;
+        const std::string game = long_game(1000);
+        load(board, game);
+        const size_t plies = 4000;
+        runner.run("undo_redo/4000_plies", 2*plies, [&](size_t) {
+            for(size_t op=0; op<plies; op++) {
+                board.undo();
+            }
+            for(size_t op=0; op<plies; op++) {
+                board.redo();
+            }
+        });
+
+        std::string saved;
+        runner.run("save_game/4000_plies", 1, [&](size_t) {
+            std::ostringstream out;
+            board.save_game(out);
+            saved = out.str();
+        });
+        runner.run("load_game/4000_plies", 1, [&](size_t) {
+            std::istringstream in(saved);
+            board.load_game(in);
+        });
+    }
+
+    {
+        // no analysis cache, benches leave nothing behind in $HOME
+        ChessFieldModel model;
+        model.reset_board();
+        const int e2 = 6*8+4, e4 = 4*8+4;
+        runner.run("model/update_cells", 2*OPS, [&](size_t ops) {
+            for(size_t op=0; op<ops/2; op++) {
+                model.make_move(e2, e4);
+                model.undo();
+            }
+        });
+        runner.run("model/update_model", OPS/10, [&](size_t ops) {
+            for(size_t op=0; op<ops; op++) {
+                model.reset_board();
+            }
+        });
+    }
+
+    return runner.report() ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+import QtQuick 2.2
+import Chess 1.0
+
+Item {
+    width : 380
+    height : 380
+
+    ChessBoardItem {
+        id : chess_field
+        model : chess_board_model
+        anchors.fill : parent
+    }
+}
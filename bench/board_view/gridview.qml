@@ -0,0 +1,87 @@
+import QtQuick 2.2
+
+// board as it was drawn before ChessBoardItem: 64 delegates driven by dataChanged
+Item {
+    width : 380
+    height : 380
+
+    Component {
+        id : board_part
+        Item {
+            id : wrapper
+            width : chess_field.cellWidth
+            height : chess_field.cellHeight
+
+            Rectangle {
+                id : board_piece
+                anchors.fill: parent
+                color : cell_color
+            }
+            Image {
+                id : chess_piece
+                source: piece ? "image://pieces/" + piece : ""
+                width : chess_field.cellWidth
+                height : chess_field.cellHeight
+                sourceSize { width : chess_field.cellWidth; height : chess_field.cellHeight }
+                cache : true
+            }
+            states : [
+                State {
+                    name : "selected"
+                    when : chess_field.selected_cell == index
+                    PropertyChanges { target : dragged_item; source :  "image://pieces/" + chess_board_model.get(index).piece;
+                                      x : mouse.mouseX - width / 2 + chess_field.x
+                                      y: mouse.mouseY - height / 2 + chess_field.y
+                    }
+                    PropertyChanges { target : chess_piece; source :  "" }
+                }
+            ]
+        }
+    }
+
+    GridView {
+        id : chess_field
+        delegate : board_part
+        model : chess_board_model
+        height : 380
+        width : 380
+        readonly property int rows_count: 8
+        readonly property int cols_count: 8
+        cellHeight : height / rows_count
+        cellWidth: width / cols_count
+
+        interactive: false
+
+        anchors.left: parent.left
+        anchors.top: parent.top
+
+        property int selected_cell : -1
+
+        MouseArea {
+            id : mouse
+            anchors.fill : parent
+            drag { maximumX: width; maximumY: height }
+
+            property int dest_ind
+
+            onPressed : {
+                chess_field.selected_cell = chess_field.indexAt(mouseX, mouseY)
+            }
+            onReleased : {
+                dest_ind = chess_field.indexAt(mouseX, mouseY)
+                if(chess_field.selected_cell != -1 && dest_ind != -1 && dest_ind != chess_field.selected_cell) {
+                    chess_board_model.make_move(chess_field.selected_cell, dest_ind);
+                }
+                chess_field.selected_cell = -1
+            }
+        }
+    }
+
+    Image {
+        id : dragged_item
+        width : chess_field.cellWidth;
+        height : chess_field.cellHeight
+        source : ""
+        sourceSize { width : chess_field.cellWidth; height : chess_field.cellHeight }
+    }
+}
@@ -0,0 +1,115 @@
+#include <QGuiApplication>
+#include <QQuickView>
+#include <QQmlEngine>
+#include <QQmlContext>
+#include <QSurfaceFormat>
+#include <QEventLoop>
+#include <QTimer>
+#include <QtQml>
+
+#include <string>
+#include <iostream>
+
+#include "../benchmark.h"
+#include "chessfieldmodel.h"
+#include "chessboarditem.h"
+#include "pieceimageprovider.h"
+
+/*
+ *  board_view [--warmup N] [--reps N] [--filter name] [--json file]
+ *
+ *  Frame times of the old 64-delegate GridView board vs ChessBoardItem.
+ *  Every frame applies one move or undo to the model & waits for the frame to be swapped,
+ *  vsync is off so the numbers are render cost rather than display refresh.
+ */
+
+static const int FRAME_TIMEOUT_MS = 1000;
+
+//false on timeout, e.g. nothing was scheduled for redraw
+static bool wait_frame(QQuickView& view)
+{
+    QEventLoop loop;
+    bool swapped = false;
+    QObject::connect(&view, &QQuickView::frameSwapped, &loop, [&]() { swapped = true; loop.quit(); });
+    QTimer::singleShot(FRAME_TIMEOUT_MS, &loop, SLOT(quit()));
+    loop.exec();
+    return swapped;
+}
+
+static void show(QQuickView& view, ChessFieldModel& model, const char* source)
+{
+    view.engine()->addImageProvider("pieces", new PieceImageProvider);
+    view.rootContext()->setContextProperty("chess_board_model", &model);
+    view.setSource(QUrl(source));
+    view.show();
+    if( !wait_frame(view) ) {
+        std::cerr << "no frame rendered for " << source << std::endl;
+        std::exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSwapInterval(0);
+    QSurfaceFormat::setDefaultFormat(format);
+
+    QGuiApplication app(argc, argv);
+    qmlRegisterType<ChessBoardItem>("Chess", 1, 0, "ChessBoardItem");
+
+    BenchmarkRunner runner(argc, argv);
+    const size_t FRAMES = 200;
+    const int e2 = 6*8+4, e4 = 4*8+4;
+
+    struct View
+    {
+        const char* name;
+        const char* source;
+    };
+    const View VIEWS[] = {
+        { "gridview",   "qrc:/bench/gridview.qml" },
+        { "board_item", "qrc:/bench/boarditem.qml" }
+    };
+
+    // models have no analysis cache, benches leave nothing behind in $HOME
+    for(size_t i=0; i<sizeof(VIEWS)/sizeof(VIEWS[0]); i++) {
+        const View& v = VIEWS[i];
+
+        // view creation, QML compilation & first frame
+        runner.run(std::string("startup/") + v.name, 1, [&](size_t) {
+            ChessFieldModel model;
+            model.reset_board();
+            QQuickView view;
+            show(view, model, v.source);
+        });
+
+        ChessFieldModel model;
+        model.reset_board();
+        QQuickView view;
+        show(view, model, v.source);
+
+        runner.run(std::string("frame/move+undo/") + v.name, FRAMES, [&](size_t ops) {
+            for(size_t op=0; op<ops; op++) {
+                if( op % 2 == 0 ) {
+                    model.make_move(e2, e4);
+                } else {
+                    model.undo();
+                }
+                wait_frame(view);
+            }
+        });
+        // whole board update, the move is needed so reset really changes something
+        runner.run(std::string("frame/move+reset/") + v.name, FRAMES, [&](size_t ops) {
+            for(size_t op=0; op<ops; op++) {
+                if( op % 2 == 0 ) {
+                    model.make_move(e2, e4);
+                } else {
+                    model.reset_board();
+                }
+                wait_frame(view);
+            }
+        });
+    }
+
+    return runner.report() ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -std=c++11 -O2
+LIBS += -pthread
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../gamemanager.cpp \
+    ../../chessboard.cpp \
+    ../../chesspiecemove.cpp \
+    ../../zobrist.cpp
+
+HEADERS += \
+    ../../gamemanager.h \
+    ../../chessboard.h \
+    ../../chesspiecemove.h \
+    ../../zobrist.h
+
+include(../../instrumentation.pri)
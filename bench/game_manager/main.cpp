@@ -0,0 +1,128 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+
+#include "gamemanager.h"
+#include "chessboard.h"
+
+/*
+ *  game_manager [games] [seconds per run]
+ *
+ *  Creates lots of games, reports memory per game, then plays scripted games
+ *  (moves mixed with undos) from 1..N threads and reports moves per second.
+ */
+
+static const char* SCRIPTS[] = {
+    "[e2,e4] [d7,d5] [e4,d5] [g8,f6] [g1,f3] [f6,d5] [f1,c4] [c8,g4] [e1,h1] [b8,c6] [d2,d3] [d8,d6] "
+    "[c1,e3] [e8,a8] [a2,a4] [b7,b5] [a4,b5] [h7,h5] [b5,c6] [h5,h4] [a1,a7] [h4,h3] [a7,a6] [h3,g2] "
+    "[a6,a5] [g2,f1] [g1,f1]",
+    "[d2,d4] [d7,d5] [c2,c4] [e7,e6] [b1,c3] [g8,f6] [c1,g5] [f8,e7] [e2,e3] [e8,h8] [g1,f3] [b8,d7] "
+    "[a1,c1] [c7,c6] [f1,d3] [d5,c4] [d3,c4] [f6,d5] [g5,e7] [d8,e7] [e1,h1] [d5,c3] [c1,c3] [e6,e5]",
+    "[g1,f3] [g8,f6] [g2,g3] [g7,g6] [f1,g2] [f8,g7] [e1,h1] [e8,h8] [d2,d3] [d7,d6] [e2,e4] [e7,e5] "
+    "[b1,c3] [b8,c6] [c1,g5] [h7,h6] [g5,f6] [g7,f6] [c3,d5] [f6,g7]"
+};
+static const int SCRIPTS_COUNT = sizeof(SCRIPTS)/sizeof(SCRIPTS[0]);
+
+typedef std::vector<std::pair<vec2,vec2> > Script;
+
+static Script parse_script(const char* text)
+{
+    Script script;
+    std::istringstream in(text);
+    vec2 src, dst;
+    while( in >> std::ws, !in.eof() && ChessBoard::read_move(in, src, dst) ) {
+        script.push_back(std::make_pair(src, dst));
+    }
+    return script;
+}
+
+struct GameState
+{
+    GameManager::GameId id;
+    const Script* script;
+    size_t ply;
+};
+
+static void play(GameManager& manager, std::vector<GameState>& games, size_t first, size_t step,
+                 double seconds, unsigned seed, uint64_t& moves)
+{
+    std::mt19937 rnd(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    moves = 0;
+    while( std::chrono::steady_clock::now() < deadline ) {
+        for(int i=0; i<1024; i++) {
+            GameState& game = games[first + (rnd() % ((games.size() - first + step - 1) / step)) * step];
+            bool forward = game.ply < game.script->size() && (game.ply == 0 || percent(rnd) < 70);
+            if( forward ) {
+                const std::pair<vec2,vec2>& move = (*game.script)[game.ply];
+                if( !manager.make_move(game.id, move.first, move.second) ) {
+                    std::cerr << "scripted move rejected" << std::endl;
+                    std::abort();
+                }
+                game.ply++;
+            } else {
+                manager.undo(game.id);
+                game.ply--;
+            }
+            moves++;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t games_count = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 50000;
+    const double seconds = (argc > 2) ? std::atof(argv[2]) : 1.0;
+    const int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    Script scripts[SCRIPTS_COUNT];
+    for(int i=0; i<SCRIPTS_COUNT; i++) {
+        scripts[i] = parse_script(SCRIPTS[i]);
+    }
+
+    GameManager manager;
+    std::vector<GameState> games(games_count);
+    for(size_t i=0; i<games_count; i++) {
+        games[i].id = manager.create_game();
+        games[i].script = &scripts[i % SCRIPTS_COUNT];
+        games[i].ply = 0;
+    }
+    // every game gets a full history so memory is measured for real games
+    for(size_t i=0; i<games_count; i++) {
+        for(; games[i].ply < games[i].script->size(); games[i].ply++) {
+            const std::pair<vec2,vec2>& move = (*games[i].script)[games[i].ply];
+            manager.make_move(games[i].id, move.first, move.second);
+        }
+    }
+    std::cout << "games: " << manager.games_count() << std::endl;
+    std::cout << "bytes per position: " << sizeof(PackedPosition) << std::endl;
+    std::cout << "bytes per game (with history): " << static_cast<double>(manager.memory_usage()) / games_count << std::endl;
+
+    std::vector<int> thread_counts;
+    for(int threads=1; threads<max_threads; threads*=2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for(auto iter=thread_counts.begin(); iter!=thread_counts.end(); iter++) {
+        const int threads = *iter;
+        std::vector<std::thread> workers;
+        std::vector<uint64_t> moves(threads);
+        for(int t=0; t<threads; t++) {
+            workers.push_back(std::thread(play, std::ref(manager), std::ref(games), t, threads,
+                                          seconds, 1234u + t, std::ref(moves[t])));
+        }
+        uint64_t total = 0;
+        for(int t=0; t<threads; t++) {
+            workers[t].join();
+            total += moves[t];
+        }
+        std::cout << "threads: " << threads << "\tmoves/s: " << static_cast<uint64_t>(total / seconds) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <string>
+#include <iostream>
+#include <cstdlib>
+
+#include "../benchmark.h"
+#include "search.h"
+
+/*
+ *  search [--warmup N] [--reps N] [--filter name] [--json file]
+ *
+ *  Cost of multi-PV against single-PV search at equal depth,
+ *  every repetition starts with an empty transposition table.
+ */
+
+struct BenchPosition
+{
+    const char* name;
+    const char* fen;
+};
+
+static const BenchPosition POSITIONS[] = {
+    { "start",      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1" },
+    { "italian",    "r1bqk1nr/pppp1ppp/2n5/2b1p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4" },
+    { "middlegame", "r2q1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R2Q1RK1 w - - 0 10" },
+    { "endgame",    "8/5pk1/6p1/8/3K4/8/5PPP/8 w - - 0 40" }
+};
+
+static const int DEPTH = 5;
+static const int MULTI_PV[] = { 1, 3, 5 };
+
+int main(int argc, char *argv[])
+{
+    BenchmarkRunner runner(argc, argv);
+    TranspositionTable tt(32);
+
+    for(size_t i=0; i<sizeof(POSITIONS)/sizeof(POSITIONS[0]); i++) {
+        Position pos;
+        if( !pos.set_fen(POSITIONS[i].fen) ) {
+            std::cerr << "bad benchmark position: " << POSITIONS[i].fen << std::endl;
+            return 1;
+        }
+        for(size_t j=0; j<sizeof(MULTI_PV)/sizeof(MULTI_PV[0]); j++) {
+            SearchLimits limits;
+            limits.depth = DEPTH;
+            limits.multi_pv = MULTI_PV[j];
+
+            uint64_t nodes = 0;
+            std::string name = std::string("search/") + POSITIONS[i].name + "/multi_pv_" +
+                               std::to_string(MULTI_PV[j]);
+            runner.run(name, 1, [&](size_t) {
+                Searcher searcher(tt);
+                nodes = searcher.search(pos, limits).nodes;
+            }, [&]() {
+                tt.clear();
+            });
+            std::cout << name << ": " << nodes << " nodes at depth " << DEPTH << std::endl;
+        }
+    }
+
+    return runner.report() ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= qt app_bundle
+
+QMAKE_CXXFLAGS += -std=c++11 -O2
+LIBS += -pthread
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../benchmark.cpp \
+    ../../search.cpp \
+    ../../pawntable.cpp \
+    ../../timemanager.cpp \
+    ../../position.cpp \
+    ../../chessboard.cpp \
+    ../../chesspiecemove.cpp \
+    ../../zobrist.cpp
+
+HEADERS += \
+    ../benchmark.h \
+    ../../search.h \
+    ../../pawntable.h \
+    ../../timemanager.h \
+    ../../position.h \
+    ../../chessboard.h \
+    ../../chesspiecemove.h \
+    ../../zobrist.h
+
+include(../../instrumentation.pri)
@@ -5,7 +5,20 @@ QT += qml quick
 SOURCES += main.cpp \
     chessfieldmodel.cpp \
     chessboard.cpp \
-    chesspiecemove.cpp
+    chesspiecemove.cpp \
+    zobrist.cpp \
+    positionindex.cpp \
+    mappedfile.cpp \
+    gamejournal.cpp \
+    pieceimageprovider.cpp \
+    chessboarditem.cpp \
+    position.cpp \
+    search.cpp \
+    pawntable.cpp \
+    timemanager.cpp \
+    analysiscache.cpp \
+    preanalyzer.cpp \
+    engineplayer.cpp
 
 RESOURCES += qml.qrc
 
@@ -17,10 +30,24 @@ QML_IMPORT_PATH =
 
 # Default rules for deployment.
 include(deployment.pri)
+include(instrumentation.pri)
 
 HEADERS += \
     chessfieldmodel.h \
     chessboard.h \
-    chesspiecemove.h
+    chesspiecemove.h \
+    zobrist.h \
+    positionindex.h \
+    mappedfile.h \
+    gamejournal.h \
+    pieceimageprovider.h \
+    chessboarditem.h \
+    position.h \
+    search.h \
+    pawntable.h \
+    timemanager.h \
+    analysiscache.h \
+    preanalyzer.h \
+    engineplayer.h
 
 
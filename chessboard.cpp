@@ -1,9 +1,12 @@
 #include "chessboard.h"
 #include "chesspiecemove.h"
+#include "zobrist.h"
+#include "instrumentation.h"
 
 #include <cstring>
 #include <cstdlib>
 #include <algorithm>
+#include <sstream>
 
 using std::get;
 using std::pair;
@@ -55,14 +58,172 @@ inline bool is_pawn_ready_to_promotion(const vec2& idx, ChessPiece cp)
  * ChessBoard implementation
  */
 
+const uint32_t ChessBoard::ROOT;
+const uint32_t ChessBoard::NIL;
+
 ChessBoard::ChessBoard():
     m_board_mgr(m_chess_board, m_1st_move_flags)
 {
     clean_board();
 }
 
+ChessBoard& ChessBoard::operator=(ChessBoard&& other)
+{
+    if( this == &other ) {
+        return *this;
+    }
+    std::copy(&other.m_chess_board[0][0], &other.m_chess_board[0][0] + ROWS*COLS, &m_chess_board[0][0]);
+    std::copy(&other.m_1st_move_flags[0][0], &other.m_1st_move_flags[0][0] + ROWS*COLS, &m_1st_move_flags[0][0]);
+    m_current_side = other.m_current_side;
+    m_tree = std::move(other.m_tree);
+    m_line = std::move(other.m_line);
+    m_line_nodes = std::move(other.m_line_nodes);
+    m_ply = other.m_ply;
+    m_hash_history = std::move(other.m_hash_history);
+    m_halfmove_history = std::move(other.m_halfmove_history);
+    // every square is marked dirty
+    m_board_mgr.sync();
+
+    other.clean_board();
+    return *this;
+}
+
 std::shared_ptr<ChessMove> ChessBoard::make_move(const vec2& src, const vec2& dst)
 {
+    PROBE_SCOPE(Probe::MAKE_MOVE);
+    auto result = create_move(src, dst);
+
+    if( !result || !result->apply(m_board_mgr) ) {
+        return shared_ptr<ChessMove>(NULL);
+    }
+
+    // move played earlier from this position is not stored twice
+    const PackedMove packed = pack_move(src, dst);
+    uint32_t node = find_child(current_node(), packed);
+    if( node == NIL ) {
+        node = add_child(current_node(), packed);
+    }
+
+    m_line.resize(m_ply);
+    m_line_nodes.resize(m_ply);
+    m_line.push_back(result);
+    m_line_nodes.push_back(node);
+
+    apply_move(result);
+    return result;
+}
+
+std::shared_ptr<ChessMove> ChessBoard::undo()
+{
+    PROBE_SCOPE(Probe::UNDO);
+    if( m_ply > 0 && m_line[m_ply-1]->undo(m_board_mgr) ) {
+        m_ply--;
+        m_current_side = 1-m_current_side;
+        m_hash_history.pop_back();
+        m_halfmove_history.pop_back();
+        return m_line[m_ply];
+    }
+    return shared_ptr<ChessMove>(NULL);
+}
+
+std::shared_ptr<ChessMove> ChessBoard::redo()
+{
+    PROBE_SCOPE(Probe::REDO);
+    if( m_ply == static_cast<int>(m_line.size()) ) {
+        uint32_t child = m_tree[current_node()].first_child;
+        if( child == NIL ) {
+            return shared_ptr<ChessMove>(NULL);
+        }
+        auto move = create_move(unpacked_src(m_tree[child].move), unpacked_dst(m_tree[child].move));
+        if( !move ) {
+            return shared_ptr<ChessMove>(NULL);
+        }
+        m_line.push_back(move);
+        m_line_nodes.push_back(child);
+    }
+
+    auto move = m_line[m_ply];
+    if( !move->apply(m_board_mgr) ) {
+        return shared_ptr<ChessMove>(NULL);
+    }
+    apply_move(move);
+    return move;
+}
+
+bool ChessBoard::next_variation()
+{
+    if( m_ply == 0 ) {
+        return false;
+    }
+    return select_sibling(m_tree[current_node()].next_sibling);
+}
+
+bool ChessBoard::prev_variation()
+{
+    if( m_ply == 0 ) {
+        return false;
+    }
+    const uint32_t node = current_node();
+    uint32_t prev = NIL;
+    for(uint32_t iter = m_tree[m_tree[node].parent].first_child; iter != node; iter = m_tree[iter].next_sibling) {
+        prev = iter;
+    }
+    return select_sibling(prev);
+}
+
+int ChessBoard::get_variations_count() const
+{
+    if( m_ply == 0 ) {
+        return 1;
+    }
+    int count = 0;
+    for(uint32_t iter = m_tree[m_tree[current_node()].parent].first_child; iter != NIL; iter = m_tree[iter].next_sibling) {
+        count++;
+    }
+    return count;
+}
+
+int ChessBoard::get_variation_index() const
+{
+    if( m_ply == 0 ) {
+        return 0;
+    }
+    const uint32_t node = current_node();
+    int ind = 0;
+    for(uint32_t iter = m_tree[m_tree[node].parent].first_child; iter != node; iter = m_tree[iter].next_sibling) {
+        ind++;
+    }
+    return ind;
+}
+
+std::vector<PackedMove> ChessBoard::get_current_line() const
+{
+    std::vector<PackedMove> line;
+    line.reserve(m_ply);
+    for(int i=0; i<m_ply; i++) {
+        line.push_back(m_tree[m_line_nodes[i]].move);
+    }
+    return line;
+}
+
+std::vector<PackedMove> ChessBoard::get_upcoming_moves(size_t max_count) const
+{
+    std::vector<PackedMove> moves;
+    uint32_t node = current_node();
+    // undone moves of the line, then first variations like redo
+    for(size_t i=m_ply; moves.size()<max_count; i++) {
+        node = (i < m_line_nodes.size()) ? m_line_nodes[i] : m_tree[node].first_child;
+        if( node == NIL ) {
+            break;
+        }
+        moves.push_back(m_tree[node].move);
+    }
+    return moves;
+}
+
+std::shared_ptr<ChessMove> ChessBoard::create_move(const vec2& src, const vec2& dst)
+{
+    PROBE_SCOPE(Probe::MOVE_VALIDATION);
     ChessPiece piece = m_chess_board[src[0]][src[1]];
 
     if( (m_current_side == WHITE && is_black(piece)) || (m_current_side == BLACK && is_white(piece)) ) {
@@ -94,45 +255,49 @@ std::shared_ptr<ChessMove> ChessBoard::make_move(const vec2& src, const vec2& ds
             //result = WRONG;
             break;
     }
+    return result;
+}
 
-    if( !result || !result->apply(m_board_mgr) ) {
-        return shared_ptr<ChessMove>(NULL);
-    }
-
+void ChessBoard::apply_move(const std::shared_ptr<ChessMove>& move)
+{
     m_current_side = 1-m_current_side;
 
-    // in case when we have loaded game
-    m_moves.erase(m_current_move, m_moves.end());
-
-    m_moves.push_back(result);
-    m_current_move = m_moves.end();
+    int halfmove_clock = move->is_irreversible() ? 0 : get_halfmove_clock()+1;
+    m_ply++;
+    m_hash_history.push_back(get_hash());
+    m_halfmove_history.push_back(halfmove_clock);
+}
 
-    return result;
+uint32_t ChessBoard::find_child(uint32_t node, PackedMove move) const
+{
+    uint32_t iter = m_tree[node].first_child;
+    while( iter != NIL && m_tree[iter].move != move ) {
+        iter = m_tree[iter].next_sibling;
+    }
+    return iter;
 }
 
-std::shared_ptr<ChessMove> ChessBoard::undo()
+uint32_t ChessBoard::add_child(uint32_t node, PackedMove move)
 {
+    VariationNode child = { move, node, NIL, NIL };
+    const uint32_t ind = static_cast<uint32_t>(m_tree.size());
+    m_tree.push_back(child);
 
-    if(m_current_move != m_moves.begin()) {
-        auto prev = m_current_move; prev--;
-        if ((*prev)->undo(m_board_mgr)) {
-            m_current_move = prev;
-            m_current_side = 1-m_current_side;
-            return shared_ptr<ChessMove>(*(m_current_move));
-        }
+    uint32_t* link = &m_tree[node].first_child;
+    while( *link != NIL ) {
+        link = &m_tree[*link].next_sibling;
     }
-    return shared_ptr<ChessMove>(NULL);
+    *link = ind;
+    return ind;
 }
 
-std::shared_ptr<ChessMove> ChessBoard::redo()
+bool ChessBoard::select_sibling(uint32_t sibling)
 {
-    if(m_current_move != m_moves.end() &&
-      (*m_current_move)->apply(m_board_mgr))
-    {
-        m_current_side = 1-m_current_side;
-        return shared_ptr<ChessMove>(*(m_current_move++));
+    if( sibling == NIL || !undo() ) {
+        return false;
     }
-    return shared_ptr<ChessMove>(NULL);
+    PackedMove move = m_tree[sibling].move;
+    return static_cast<bool>(make_move(unpacked_src(move), unpacked_dst(move)));
 }
 
 std::shared_ptr<ChessMove> ChessBoard::pawn_move(const vec2& src, const vec2& dst) const
@@ -279,6 +444,93 @@ bool ChessBoard::is_king_under_attack() const
     return false;
 }
 
+uint64_t ChessBoard::get_hash() const
+{
+    uint64_t hash = m_board_mgr.get_hash();
+    return (m_current_side == BLACK) ? hash ^ Zobrist::black_to_move() : hash;
+}
+
+int ChessBoard::get_repetition_count() const
+{
+    // position can't repeat across capture or pawn move,
+    // so only the reversible tail of history is checked
+    const uint64_t hash = m_hash_history[m_ply];
+    const int first = std::max(0, m_ply - get_halfmove_clock());
+    int count = 1;
+    for(int i=m_ply-2; i>=first; i-=2) {
+        if( m_hash_history[i] == hash ) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool ChessBoard::is_insufficient_material() const
+{
+    const BoardMgr& b = m_board_mgr;
+    if( b.get_piece_count(ChessPiece::WT_KING) == 0 || b.get_piece_count(ChessPiece::BK_KING) == 0 ) {
+        return false;
+    }
+    if( b.get_piece_count(ChessPiece::WT_PAWN) || b.get_piece_count(ChessPiece::BK_PAWN) ||
+        b.get_piece_count(ChessPiece::WT_QUEEN) || b.get_piece_count(ChessPiece::BK_QUEEN) ||
+        b.get_piece_count(ChessPiece::WT_CASTLE) || b.get_piece_count(ChessPiece::BK_CASTLE) )
+    {
+        return false;
+    }
+
+    int wt_bishops = b.get_piece_count(ChessPiece::WT_BISHOP);
+    int bk_bishops = b.get_piece_count(ChessPiece::BK_BISHOP);
+    int wt_minors = wt_bishops + b.get_piece_count(ChessPiece::WT_KNIGHT);
+    int bk_minors = bk_bishops + b.get_piece_count(ChessPiece::BK_KNIGHT);
+
+    // king vs king, king & minor piece vs king
+    if( wt_minors + bk_minors <= 1 ) {
+        return true;
+    }
+    // king & bishop vs king & bishop with bishops on the same color
+    if( wt_minors == 1 && bk_minors == 1 && wt_bishops == 1 && bk_bishops == 1 ) {
+        int colors[2] = {-1, -1};
+        for(int r=0; r<ROWS; r++) {
+            for(int c=0; c<COLS; c++) {
+                ChessPiece cp = m_chess_board[r][c];
+                if( cp == ChessPiece::WT_BISHOP || cp == ChessPiece::BK_BISHOP ) {
+                    colors[is_white(cp) ? 0 : 1] = (r+c) % 2;
+                }
+            }
+        }
+        return colors[0] == colors[1];
+    }
+    return false;
+}
+
+ChessBoard::DrawReason ChessBoard::get_draw_reason() const
+{
+    if( is_insufficient_material() ) {
+        return DrawReason::INSUFFICIENT_MATERIAL;
+    }
+    if( get_halfmove_clock() >= FIFTY_MOVES_PLIES ) {
+        return DrawReason::FIFTY_MOVES;
+    }
+    if( get_repetition_count() >= 3 ) {
+        return DrawReason::REPETITION;
+    }
+    return DrawReason::NONE;
+}
+
+void ChessBoard::reset_history(int halfmove_clock)
+{
+    m_board_mgr.sync();
+
+    VariationNode root = { NO_MOVE, NIL, NIL, NIL };
+    m_tree.assign(1, root);
+    m_line.clear();
+    m_line_nodes.clear();
+    m_ply = 0;
+
+    m_hash_history.assign(1, get_hash());
+    m_halfmove_history.assign(1, halfmove_clock);
+}
+
 void ChessBoard::reset_board()
 {
     clean_board();
@@ -300,53 +552,130 @@ void ChessBoard::reset_board()
     }
 
     m_current_side = WHITE;
+    reset_history(0);
 }
 
 void ChessBoard::clean_board()
 {
     memset(m_chess_board,0,sizeof(m_chess_board));
+    memset(m_1st_move_flags,0,sizeof(m_1st_move_flags));
 
-    m_moves.clear();
-    m_current_move = m_moves.end();
+    m_current_side = WHITE;
+    reset_history(0);
 }
 
-bool ChessBoard::save_game(std::ostream& stream)
+bool ChessBoard::read_move(std::istream& stream, vec2& src, vec2& dst)
+{
+    char ch;
+    bool res = true;
+    stream >> ch;
+    res = res && read_vec2(stream, src);
+    stream >> ch;
+    res = res && read_vec2(stream, dst);
+    stream >> ch;
+    return res;
+}
+
+bool ChessBoard::write_move(std::ostream& stream, const vec2& src, const vec2& dst)
 {
     bool ret = true;
-    for(auto iter=m_moves.begin(); iter!=m_current_move; iter++)
-    {
-        stream << "[";
-        ret = ret && write_vec2(stream, (*iter)->get_src_pos());
-        stream << ",";
-        ret = ret && write_vec2(stream, (*iter)->get_dst_pos());
-        stream << "] ";
-    }
+    stream << "[";
+    ret = ret && write_vec2(stream, src);
+    stream << ",";
+    ret = ret && write_vec2(stream, dst);
+    stream << "] ";
     return ret;
 }
 
-bool ChessBoard::load_game(std::istream& stream)
+std::string ChessBoard::moves_to_string(const std::vector<PackedMove>& moves)
 {
+    std::ostringstream out;
+    for(size_t i=0; i<moves.size(); i++) {
+        write_move(out, unpacked_src(moves[i]), unpacked_dst(moves[i]));
+    }
+    std::string res = out.str();
+    return res.substr(0, res.find_last_not_of(' ') + 1);
+}
+
+void ChessBoard::set_position(const ChessPiece (&board)[ROWS][COLS], const bool (&first_move_flags)[ROWS][COLS],
+                              int side, int halfmove_clock)
+{
+    memcpy(m_chess_board, board, sizeof(m_chess_board));
+    memcpy(m_1st_move_flags, first_move_flags, sizeof(m_1st_move_flags));
+
+    m_current_side = side;
+    reset_history(halfmove_clock);
+}
+
+void ChessBoard::write_variations(std::ostream& stream, uint32_t node) const
+{
+    for(uint32_t child = m_tree[node].first_child; child != NIL; child = m_tree[child].first_child) {
+        write_move(stream, unpacked_src(m_tree[child].move), unpacked_dst(m_tree[child].move));
+        for(uint32_t sibling = m_tree[child].next_sibling; sibling != NIL; sibling = m_tree[sibling].next_sibling) {
+            stream << "( ";
+            write_move(stream, unpacked_src(m_tree[sibling].move), unpacked_dst(m_tree[sibling].move));
+            write_variations(stream, sibling);
+            stream << ") ";
+        }
+    }
+}
+
+bool ChessBoard::save_game(std::ostream& stream)
+{
+    PROBE_SCOPE(Probe::SAVE_GAME);
+    write_variations(stream, ROOT);
+    return stream.good();
+}
+
+bool ChessBoard::load_game(std::istream& stream, const LoadCallback& callback)
+{
+    PROBE_SCOPE(Probe::LOAD_GAME);
     if( !stream ) {
         return false;
     }
     reset_board();
 
-    bool res = true;
+    // opened variations: ply before the replaced move & the move itself
+    std::vector<std::pair<int, PackedMove> > variations;
     vec2 src, dst;
+    int moves = 0;
     while( stream )
     {
-        char ch;
-        stream >> ch;
+        stream >> std::ws;
         if( stream.eof() ) {
             break;
         }
-        res = res && read_vec2(stream, src);
-        stream >> ch;
-        res = res && read_vec2(stream, dst);
-        stream >> ch;
-        if( !res || !make_move(src, dst)) {
-            return false;
+        switch( stream.peek() ) {
+            case '(':
+                stream.get();
+                if( m_ply == 0 ) {
+                    return false;
+                }
+                variations.push_back(std::make_pair(m_ply-1, m_tree[current_node()].move));
+                undo();
+                break;
+            case ')': {
+                stream.get();
+                if( variations.empty() ) {
+                    return false;
+                }
+                while( m_ply > variations.back().first ) {
+                    undo();
+                }
+                PackedMove move = variations.back().second;
+                variations.pop_back();
+                make_move(unpacked_src(move), unpacked_dst(move));
+                break;
+            }
+            default:
+                if( !read_move(stream, src, dst) || !make_move(src, dst)) {
+                    return false;
+                }
+                if( callback && ++moves % LOAD_CHECK_MOVES == 0 && !callback() ) {
+                    return false;
+                }
+                break;
         }
     }
-    return true;
+    return variations.empty();
 }
@@ -3,8 +3,11 @@
 
 #include <utility>
 #include <memory>
-#include <list>
+#include <vector>
 #include <iostream>
+#include <string>
+#include <functional>
+#include <cstdint>
 
 #include "chesspiecemove.h"
 
@@ -18,28 +21,111 @@ public:
         A=0,B,C,D,E,F,G,H
     };
 
+    enum class DrawReason{
+        NONE=0,
+        REPETITION,
+        FIFTY_MOVES,
+        INSUFFICIENT_MATERIAL
+    };
+
+    static const int FIFTY_MOVES_PLIES = 100;
+    //load_game calls its callback after every LOAD_CHECK_MOVES moves read
+    static const int LOAD_CHECK_MOVES = 1024;
+
+    static const int BLACK = 0;
+    static const int WHITE = 1;
+
 public:
+    //returns false to stop loading
+    typedef std::function<bool()> LoadCallback;
+
     ChessBoard();
+    //takes over position & history, board manager stays bound to this board; other is left empty
+    ChessBoard& operator=(ChessBoard&& other);
     void reset_board();
     void clean_board();
+    //sets arbitrary position without history
+    void set_position(const ChessPiece (&board)[ROWS][COLS], const bool (&first_move_flags)[ROWS][COLS],
+                      int side, int halfmove_clock);
 
-    ChessPiece get_board_piece(int r, int c)
+    ChessPiece get_board_piece(int r, int c) const
     {
         return m_chess_board[r][c];
     }
+    bool is_1st_move(int r, int c) const            {   return m_1st_move_flags[r][c];  }
+    int get_current_side() const                    {   return m_current_side;  }
 
     //first 3 parameters - for common case,
     // 4,5 - in case of castling
     std::shared_ptr<ChessMove> make_move(const vec2& src, const vec2& dst);
 
     std::shared_ptr<ChessMove> undo();
+    //replays undone move, at the end of line goes into the first variation
     std::shared_ptr<ChessMove> redo();
 
+    //replaces the last move by its next/previous sibling variation
+    bool next_variation();
+    bool prev_variation();
+    //number of alternatives to the last move (including itself) & index of the current one
+    int get_variations_count() const;
+    int get_variation_index() const;
+    //moves from the start position to the current one
+    std::vector<PackedMove> get_current_line() const;
+    int get_ply() const                             {   return m_ply;   }
+    //moves redo would replay from the current position, at most max_count of them
+    std::vector<PackedMove> get_upcoming_moves(size_t max_count) const;
+    size_t get_variation_nodes_count() const        {   return m_tree.size();   }
+
+    //whole variation tree is saved, alternatives follow the move they replace in parentheses:
+    //"[e2,e4] ( [d2,d4] [d7,d5] ) [e7,e5] "; loaded game is positioned at the end of the main line
     bool save_game(std::ostream& stream);
-    bool load_game(std::istream& stream);
+    bool load_game(std::istream& stream, const LoadCallback& callback = LoadCallback());
+
+    //single "[e2,e4]" item of the save format
+    static bool read_move(std::istream& stream, vec2& src, vec2& dst);
+    static bool write_move(std::ostream& stream, const vec2& src, const vec2& dst);
+    //"[e2,e4] [e7,e5]" without the trailing space of write_move
+    static std::string moves_to_string(const std::vector<PackedMove>& moves);
 
     bool is_king_under_attack() const;
+
+    //hash of current position including side to move & castling flags
+    uint64_t get_hash() const;
+    //hash of pawns only, equal to Position::get_pawn_hash()
+    uint64_t get_pawn_hash() const                  {   return m_board_mgr.get_pawn_hash();   }
+    //plies since last capture or pawn move
+    int get_halfmove_clock() const                  {   return m_halfmove_history[m_ply];   }
+    //how many times current position occurred (1 if it's new)
+    int get_repetition_count() const;
+    bool is_insufficient_material() const;
+    DrawReason get_draw_reason() const;
+
+    //squares changed since the previous call, bit r*8+c, see BoardMgr
+    uint64_t take_dirty_squares()                   {   return m_board_mgr.take_dirty_squares();   }
 private:
+    ChessBoard(const ChessBoard&);
+    ChessBoard& operator=(const ChessBoard&);
+
+    void reset_history(int halfmove_clock);
+
+    struct VariationNode
+    {
+        PackedMove move;
+        uint32_t parent;
+        uint32_t first_child;
+        uint32_t next_sibling;
+    };
+    static const uint32_t ROOT = 0;
+    static const uint32_t NIL = UINT32_MAX;
+
+    std::shared_ptr<ChessMove> create_move(const vec2& src, const vec2& dst);
+    void apply_move(const std::shared_ptr<ChessMove>& move);
+    uint32_t current_node() const                   {   return m_ply ? m_line_nodes[m_ply-1] : ROOT;   }
+    uint32_t find_child(uint32_t node, PackedMove move) const;
+    uint32_t add_child(uint32_t node, PackedMove move);
+    bool select_sibling(uint32_t sibling);
+    void write_variations(std::ostream& stream, uint32_t node) const;
+
     std::shared_ptr<ChessMove> pawn_move(const vec2& src, const vec2& dst) const;
     std::shared_ptr<ChessMove> castle_move(const vec2& src, const vec2& dst);
     std::shared_ptr<ChessMove> bishop_move(const vec2& src, const vec2& dst);
@@ -53,14 +139,19 @@ private:
     ChessPiece m_chess_board[8][8];
     bool m_1st_move_flags[8][8];
 
-    static const int BLACK = 0;
-    static const int WHITE = 1;
-
     int m_current_side;
 
-    typedef std::list<std::shared_ptr<ChessMove> > PieceMoves;
-    PieceMoves m_moves;
-    PieceMoves::iterator m_current_move;
+    //all played moves, every node is a move from its parent position, children are in order of adding
+    std::vector<VariationNode> m_tree;
+
+    //current line: moves from the start position & their nodes, moves after m_ply are undone ones
+    std::vector<std::shared_ptr<ChessMove> > m_line;
+    std::vector<uint32_t> m_line_nodes;
+    int m_ply;
+
+    //per position of the current line up to m_ply: hash & halfmove clock
+    std::vector<uint64_t> m_hash_history;
+    std::vector<int> m_halfmove_history;
 
     BoardMgr m_board_mgr;
 };
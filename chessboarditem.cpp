@@ -0,0 +1,213 @@
+#include "chessboarditem.h"
+#include "pieceimageprovider.h"
+
+#include <QQuickWindow>
+#include <QSGSimpleRectNode>
+#include <QSGSimpleTextureNode>
+#include <QMouseEvent>
+#include <QColor>
+#include <cmath>
+#include <algorithm>
+
+static const uint64_t ALL_SQUARES = ~uint64_t(0);
+
+inline int to_list_index(int square)
+{
+    return (ChessBoardItem::ROWS-1 - square/ChessBoardItem::COLS)*ChessBoardItem::COLS + square%ChessBoardItem::COLS;
+}
+
+/*
+ *  BoardNode: 64 squares, 64 pieces on top & dragged piece above everything
+ */
+
+class ChessBoardItem::BoardNode : public QSGNode
+{
+public:
+    BoardNode():
+        atlas(NULL)
+    {
+        for(int i=0; i<SQUARES; i++) {
+            squares[i] = new QSGSimpleRectNode();
+            // rank 1 is at the bottom, a1 is dark
+            bool light = (i/COLS + i%COLS) % 2 != 0;
+            squares[i]->setColor(QColor(light ? "white" : "brown"));
+            appendChildNode(squares[i]);
+        }
+        for(int i=0; i<SQUARES; i++) {
+            pieces[i] = new QSGSimpleTextureNode();
+            appendChildNode(pieces[i]);
+        }
+        dragged = new QSGSimpleTextureNode();
+        appendChildNode(dragged);
+    }
+    ~BoardNode()
+    {
+        delete atlas;
+    }
+
+    QSGSimpleRectNode* squares[SQUARES];
+    QSGSimpleTextureNode* pieces[SQUARES];
+    QSGSimpleTextureNode* dragged;
+
+    QSGTexture* atlas;
+    QSize atlas_cell_size;          //in device pixels
+};
+
+/*
+ *  ChessBoardItem implementation
+ */
+
+ChessBoardItem::ChessBoardItem(QQuickItem* parent):
+    QQuickItem(parent), m_dirty(ALL_SQUARES), m_geometry_dirty(true), m_drag_square(-1)
+{
+    std::fill_n(m_pieces, SQUARES, to_int(ChessPiece::NONE));
+    setFlag(ItemHasContents, true);
+    setAcceptedMouseButtons(Qt::LeftButton);
+}
+
+void ChessBoardItem::set_model(ChessFieldModel* model)
+{
+    if( m_model == model ) {
+        return;
+    }
+    if( m_model ) {
+        disconnect(m_model, 0, this, 0);
+    }
+    m_model = model;
+    if( m_model ) {
+        connect(m_model, SIGNAL(board_changed(quint64)), this, SLOT(on_board_changed(quint64)));
+    }
+    on_board_changed(ALL_SQUARES);
+    emit model_changed();
+}
+
+qreal ChessBoardItem::cell_size() const
+{
+    return std::min(width(), height()) / COLS;
+}
+
+void ChessBoardItem::mark_dirty(uint64_t squares)
+{
+    m_dirty |= squares;
+    update();
+}
+
+void ChessBoardItem::on_board_changed(quint64 dirty_squares)
+{
+    for(int sq=0; sq<SQUARES; sq++) {
+        if( !(dirty_squares >> sq & 1) ) {
+            continue;
+        }
+        m_pieces[sq] = m_model ? to_int(m_model->get_board().get_board_piece(sq/COLS, sq%COLS))
+                               : to_int(ChessPiece::NONE);
+    }
+    mark_dirty(dirty_squares);
+}
+
+void ChessBoardItem::geometryChanged(const QRectF& new_geometry, const QRectF& old_geometry)
+{
+    QQuickItem::geometryChanged(new_geometry, old_geometry);
+    if( new_geometry.size() != old_geometry.size() ) {
+        m_geometry_dirty = true;
+        mark_dirty(ALL_SQUARES);
+        emit cell_size_changed();
+    }
+}
+
+int ChessBoardItem::square_at(const QPointF& pos) const
+{
+    const qreal cell = cell_size();
+    if( cell <= 0 || pos.x() < 0 || pos.y() < 0 ) {
+        return -1;
+    }
+    int c = static_cast<int>(pos.x() / cell);
+    int r = ROWS-1 - static_cast<int>(pos.y() / cell);
+    if( c >= COLS || r < 0 ) {
+        return -1;
+    }
+    return r*COLS + c;
+}
+
+void ChessBoardItem::mousePressEvent(QMouseEvent* event)
+{
+    int sq = square_at(event->localPos());
+    if( sq < 0 || m_pieces[sq] == to_int(ChessPiece::NONE) ) {
+        event->ignore();
+        return;
+    }
+    m_drag_square = sq;
+    m_drag_pos = event->localPos();
+    mark_dirty(uint64_t(1) << sq);
+}
+
+void ChessBoardItem::mouseMoveEvent(QMouseEvent* event)
+{
+    if( m_drag_square < 0 ) {
+        return;
+    }
+    m_drag_pos = event->localPos();
+    update();
+}
+
+void ChessBoardItem::mouseReleaseEvent(QMouseEvent* event)
+{
+    if( m_drag_square < 0 ) {
+        return;
+    }
+    int src = m_drag_square;
+    int dst = square_at(event->localPos());
+    m_drag_square = -1;
+    mark_dirty(uint64_t(1) << src);
+    if( m_model && dst >= 0 && dst != src ) {
+        m_model->make_move(to_list_index(src), to_list_index(dst));
+    }
+}
+
+QSGNode* ChessBoardItem::updatePaintNode(QSGNode* old_node, UpdatePaintNodeData* data)
+{
+    Q_UNUSED(data);
+    BoardNode* node = static_cast<BoardNode*>(old_node);
+    if( !node ) {
+        node = new BoardNode();
+        m_geometry_dirty = true;
+    }
+
+    const qreal cell = cell_size();
+    if( m_geometry_dirty ) {
+        m_geometry_dirty = false;
+        m_dirty = ALL_SQUARES;
+
+        // atlas is rendered in device pixels, so pieces are never scaled by the scene graph
+        qreal dpr = window()->effectiveDevicePixelRatio();
+        int side = std::max(1, static_cast<int>(std::ceil(cell * dpr)));
+        QSize atlas_cell_size(side, side);
+        if( atlas_cell_size != node->atlas_cell_size ) {
+            delete node->atlas;
+            node->atlas = window()->createTextureFromImage(PieceImageProvider::render_atlas(atlas_cell_size));
+            node->atlas_cell_size = atlas_cell_size;
+            for(int i=0; i<SQUARES; i++) {
+                node->pieces[i]->setTexture(node->atlas);
+            }
+            node->dragged->setTexture(node->atlas);
+        }
+        for(int i=0; i<SQUARES; i++) {
+            QRectF rect((i%COLS)*cell, (ROWS-1 - i/COLS)*cell, cell, cell);
+            node->squares[i]->setRect(rect);
+            node->pieces[i]->setRect(rect);
+        }
+    }
+
+    for(int sq=0; sq<SQUARES; sq++) {
+        if( !(m_dirty >> sq & 1) ) {
+            continue;
+        }
+        int piece = (sq == m_drag_square) ? to_int(ChessPiece::NONE) : m_pieces[sq];
+        node->pieces[sq]->setSourceRect(PieceImageProvider::atlas_cell(piece, node->atlas_cell_size));
+    }
+    m_dirty = 0;
+
+    int dragged = (m_drag_square >= 0) ? m_pieces[m_drag_square] : to_int(ChessPiece::NONE);
+    node->dragged->setSourceRect(PieceImageProvider::atlas_cell(dragged, node->atlas_cell_size));
+    node->dragged->setRect(m_drag_pos.x() - cell/2, m_drag_pos.y() - cell/2, cell, cell);
+    return node;
+}
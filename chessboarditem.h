@@ -0,0 +1,70 @@
+#ifndef CHESSBOARDITEM_H
+#define CHESSBOARDITEM_H
+
+#include <QQuickItem>
+#include <QPointer>
+#include <QPointF>
+
+#include "chessfieldmodel.h"
+
+/*
+ *  Whole board in one scene graph subtree: squares, pieces & dragged piece.
+ *  Only squares reported dirty by the board are touched on update,
+ *  pieces are texture nodes sharing one atlas texture.
+ */
+
+class ChessBoardItem : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(ChessFieldModel* model READ model WRITE set_model NOTIFY model_changed)
+    Q_PROPERTY(qreal cellWidth READ cell_size NOTIFY cell_size_changed)
+    Q_PROPERTY(qreal cellHeight READ cell_size NOTIFY cell_size_changed)
+    Q_PROPERTY(int rows_count READ rows_count CONSTANT)
+    Q_PROPERTY(int cols_count READ cols_count CONSTANT)
+public:
+    static const int ROWS = BoardMgr::ROWS;
+    static const int COLS = BoardMgr::COLS;
+    static const int SQUARES = ROWS*COLS;
+
+    explicit ChessBoardItem(QQuickItem* parent = 0);
+
+    ChessFieldModel* model() const                                      {   return m_model;   }
+    void set_model(ChessFieldModel* model);
+
+    qreal cell_size() const;
+    int rows_count() const                                              {   return ROWS;   }
+    int cols_count() const                                              {   return COLS;   }
+
+signals:
+    void model_changed();
+    void cell_size_changed();
+
+protected:
+    QSGNode* updatePaintNode(QSGNode* old_node, UpdatePaintNodeData* data);
+    void geometryChanged(const QRectF& new_geometry, const QRectF& old_geometry);
+
+    void mousePressEvent(QMouseEvent* event);
+    void mouseMoveEvent(QMouseEvent* event);
+    void mouseReleaseEvent(QMouseEvent* event);
+
+private slots:
+    void on_board_changed(quint64 dirty_squares);
+
+private:
+    class BoardNode;
+
+    //square r*COLS+c at pos, -1 outside of the board
+    int square_at(const QPointF& pos) const;
+    void mark_dirty(uint64_t squares);
+
+    QPointer<ChessFieldModel> m_model;
+    int m_pieces[SQUARES];          //copy of the board, read by the render thread during sync
+
+    uint64_t m_dirty;
+    bool m_geometry_dirty;
+
+    int m_drag_square;              //-1 if nothing is dragged
+    QPointF m_drag_pos;
+};
+
+#endif // CHESSBOARDITEM_H
@@ -1,65 +1,152 @@
 #include "chessfieldmodel.h"
+#include "instrumentation.h"
+
+#include <QStringList>
+#include <QMetaObject>
 
 #include <utility>
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <fstream>
 
+//explorer stats kept before the cache starts over
+static const int EXPLORER_CACHE_POSITIONS = 4096;
+
+static const char JOURNAL_SUFFIX[] = ".journal";
+static const size_t ANALYSIS_HASH_MB = 32;
+//positions after the current one analysed in advance
+static const size_t ANALYSIS_LOOKAHEAD_PLIES = 8;
+static const size_t ENGINE_HASH_MB = 32;
+static const int CLOCK_TICK_MS = 100;
+
 inline int from_board_to_list(const vec2& ind)
 {
     return (7-ind[0])*8+ind[1];
 }
 
-ChessFieldModel::ChessFieldModel(QObject *parent) :
-    QAbstractListModel(parent), m_chess_piece_images(to_int(ChessPiece::BK_PAWN)+1)
+inline std::string to_local_file(const QUrl& file)
+{
+    QByteArray ba = file.path().toLatin1();
+    if( ba.isEmpty() ) {
+        return std::string();
+    }
+    return std::string(ba.constData()+1);// because of trailing '/'
+}
+
+inline QString square_name(const vec2& v)
+{
+    return QString("%1%2").arg(QChar('a'+v[1])).arg(v[0]+1);
+}
+
+inline QString move_name(PackedMove move)
+{
+    return square_name(unpacked_src(move)) + "-" + square_name(unpacked_dst(move));
+}
+
+//white point of view, "#3" - king is taken in 3 moves
+static QString score_text(int score, int side)
+{
+    if( side == ChessBoard::BLACK ) {
+        score = -score;
+    }
+    if( score > MATE_BOUND || score < -MATE_BOUND ) {
+        int plies = MATE_SCORE - std::abs(score);
+        return QString("%1#%2").arg(score > 0 ? "" : "-").arg((plies + 1) / 2);
+    }
+    return QString("%1%2").arg(score > 0 ? "+" : "").arg(score / 100.0, 0, 'f', 2);
+}
+
+static QVariantMap analysis_item(const PvLine& line, int side)
+{
+    QStringList pv;
+    for(auto move=line.pv.begin(); move!=line.pv.end(); move++) {
+        pv.append(move_name(*move));
+    }
+    QVariantMap item;
+    item["move"] = pv.front();
+    item["score"] = score_text(line.score, side);
+    item["pv"] = pv.join(" ");
+    return item;
+}
+
+ChessFieldModel::ChessFieldModel(const std::string& analysis_cache, QObject *parent) :
+    QAbstractListModel(parent),
+    m_compacting(false), m_compact_ok(false), m_compact_replaced(false),
+    m_analyzer(ANALYSIS_HASH_MB, [this](const Position& pos, const SearchResult& result) { on_analyzed(pos, result); }),
+    m_analysis_lines(0), m_analysis_hash(0), m_analysis_depth(0),
+    m_engine(ENGINE_HASH_MB, [this](const Position& pos, const SearchResult& result) {
+        QMetaObject::invokeMethod(this, "on_engine_move", Qt::QueuedConnection,
+                                  Q_ARG(quint32, result.best_move), Q_ARG(quint64, pos.get_hash()));
+    }),
+    m_engine_side(-1), m_increment_ms(0),
+    m_file_cancel(false), m_file_busy(false), m_file_progress(0)
 {
     m_role_names[CELL_COLOR] = "cell_color";
-    m_role_names[IMAGE_PATH] = "image_path";
+    m_role_names[PIECE] = "piece";
 
+    const QString white("white"), brown("brown");
     for(int i=0; i<4; i++) {
         for(int j=0; j<4; j++) {
-            m_list.append(std::pair<QString,QString>("white",""));
-            m_list.append(std::pair<QString,QString>("brown",""));
+            m_list.append(std::pair<QString,int>(white,0));
+            m_list.append(std::pair<QString,int>(brown,0));
         }
         for(int j=0; j<4; j++) {
-            m_list.append(std::pair<QString,QString>("brown",""));
-            m_list.append(std::pair<QString,QString>("white",""));
+            m_list.append(std::pair<QString,int>(brown,0));
+            m_list.append(std::pair<QString,int>(white,0));
         }
     }
 
-    m_chess_piece_images[to_int(ChessPiece::NONE)]      = "";
-    m_chess_piece_images[to_int(ChessPiece::WT_KING)]   = "img/assets/wt_king.png";
-    m_chess_piece_images[to_int(ChessPiece::WT_QUEEN)]  = "img/assets/wt_queen.png";
-    m_chess_piece_images[to_int(ChessPiece::WT_BISHOP)] = "img/assets/wt_bishop.png";
-    m_chess_piece_images[to_int(ChessPiece::WT_KNIGHT)] = "img/assets/wt_knight.png";
-    m_chess_piece_images[to_int(ChessPiece::WT_CASTLE)] = "img/assets/wt_castle.png";
-    m_chess_piece_images[to_int(ChessPiece::WT_PAWN)]   = "img/assets/wt_pawn.png";
+    m_clock_ms[ChessBoard::WHITE] = m_clock_ms[ChessBoard::BLACK] = 0;
+    m_clock_timer.setInterval(CLOCK_TICK_MS);
+    connect(&m_clock_timer, SIGNAL(timeout()), this, SLOT(on_clock_tick()));
 
-    m_chess_piece_images[to_int(ChessPiece::BK_KING)]   = "img/assets/bk_king.png";
-    m_chess_piece_images[to_int(ChessPiece::BK_QUEEN)]  = "img/assets/bk_queen.png";
-    m_chess_piece_images[to_int(ChessPiece::BK_BISHOP)] = "img/assets/bk_bishop.png";
-    m_chess_piece_images[to_int(ChessPiece::BK_KNIGHT)] = "img/assets/bk_knight.png";
-    m_chess_piece_images[to_int(ChessPiece::BK_CASTLE)] = "img/assets/bk_castle.png";
-    m_chess_piece_images[to_int(ChessPiece::BK_PAWN)]   = "img/assets/bk_pawn.png";
+    // not having a cache only costs the analysis of earlier sessions
+    m_analysis_cache.open(analysis_cache);
 
     clean_board();
 }
 
+ChessFieldModel::~ChessFieldModel()
+{
+    m_analyzer.stop();
+    m_engine.stop();
+    if( m_compact_thread.joinable() ) {
+        m_compact_thread.join();
+    }
+    if( m_file_thread.joinable() ) {
+        m_file_cancel.store(true);
+        m_file_thread.join();
+    }
+}
+
 void ChessFieldModel::reset_board()
 {
+    if( m_file_busy ) {
+        return;
+    }
+    stop_engine_game();
+    close_journal();
     m_chess_board.reset_board();
     update_model();
 }
 
 void ChessFieldModel::clean_board()
 {
+    if( m_file_busy ) {
+        return;
+    }
+    stop_engine_game();
+    close_journal();
     m_chess_board.clean_board();
     update_model();
 }
 
 void ChessFieldModel::make_move(int src_cell, int dst_cell)
 {
-    if( m_chess_board.get_board_piece(7 - src_cell / 8, src_cell % 8) == ChessPiece::NONE ) {
+    if( m_file_busy || m_chess_board.get_board_piece(7 - src_cell / 8, src_cell % 8) == ChessPiece::NONE ||
+        m_engine_side == m_chess_board.get_current_side() ) {
         return;
     }
     auto src = make_vec2(7 - src_cell/8, src_cell%8);
@@ -69,71 +156,250 @@ void ChessFieldModel::make_move(int src_cell, int dst_cell)
     if( !res ) {
         return ;
     }
+    append_journal(GameJournal::MOVE, res);
     update_cells(res);
+    if( m_engine_side >= 0 ) {
+        switch_clock();
+        check_engine_game();
+        engine_think();
+    }
 }
 
-bool ChessFieldModel::save_game(QUrl file)
+void ChessFieldModel::append_journal(GameJournal::Action action, const std::shared_ptr<ChessMove>& move)
 {
-    QString qstr = file.path();
-    QByteArray ba = qstr.toLatin1();
-    const char *fname = ba.data();
-    if(!fname || !*fname) {
-        return false;
+    append_journal(action, pack_move(move->get_src_pos(), move->get_dst_pos()));
+}
+
+void ChessFieldModel::append_journal(GameJournal::Action action, PackedMove move)
+{
+    if( !m_journal.is_open() ) {
+        return;
     }
-    //const char* fname = qstr.toUtf8().constData();
-    std::ofstream out(fname+1);
-    if(out) {
-        bool ret = m_chess_board.save_game(out);
-        out.close();
-        return ret;
+    m_journal.append(action, move);
+    if( m_compacting ) {
+        m_compact_pending.push_back(std::make_pair(action, move));
+    } else if( m_journal.needs_compaction() ) {
+        start_compaction();
     }
-    return false;
 }
-bool ChessFieldModel::load_game(QUrl file)
+
+void ChessFieldModel::close_journal()
 {
-    QString qstr = file.path();
-    QByteArray ba = qstr.toLatin1();
-    const char *fname = ba.data();
-    if(!fname || !*fname) {
-        return false;
+    finish_compaction();
+    m_journal.close();
+    m_save_file.clear();
+}
+
+void ChessFieldModel::start_compaction()
+{
+    // only the snapshot is taken on the GUI thread, the disk work isn't
+    GameJournal::Snapshot snapshot;
+    if( !GameJournal::take_snapshot(m_chess_board, snapshot) ) {
+        m_journal.defer_compaction();
+        emit journal_failed();
+        return;
+    }
+    m_compacting = true;
+    const std::string fname = m_save_file;
+    m_compact_thread = std::thread([this, fname, snapshot]() {
+        m_compact_ok = GameJournal::compact(fname, fname + JOURNAL_SUFFIX, snapshot, m_compacted_journal,
+                                            m_compact_replaced);
+        QMetaObject::invokeMethod(this, "on_compaction_done", Qt::QueuedConnection);
+    });
+}
+
+void ChessFieldModel::finish_compaction()
+{
+    if( !m_compacting ) {
+        return;
     }
-    std::ifstream in(fname+1);// because of trailing '/'
-    if(in) {
-        bool ret = m_chess_board.load_game(in);
-        in.close();
-        update_model();
-        return ret;
+    m_compact_thread.join();
+    m_compacting = false;
+    if( m_compact_ok ) {
+        m_journal.swap(m_compacted_journal);
+        for(auto iter=m_compact_pending.begin(); iter!=m_compact_pending.end(); iter++) {
+            m_journal.append(iter->first, iter->second);
+        }
+    } else if( m_compact_replaced ) {
+        // old journal doesn't continue the new save file, nothing is journaled until the next save
+        m_journal.close();
+        m_save_file.clear();
+        emit journal_failed();
+    } else {
+        // old journal has every action, compaction is retried after more of them
+        m_journal.defer_compaction();
+        emit journal_failed();
     }
-    return false;
+    m_compacted_journal.close();
+    m_compact_pending.clear();
 }
 
+void ChessFieldModel::on_compaction_done()
+{
+    finish_compaction();
+}
+
+bool ChessFieldModel::open_position_index(QUrl file)
+{
+    std::string fname = to_local_file(file);
+    bool ret = !fname.empty() && m_position_index.open(fname);
+    m_explorer_cache.clear();
+    emit game_state_changed();
+    return ret;
+}
+
+QVariantList ChessFieldModel::explorer() const
+{
+    QVariantList res;
+    if( !m_position_index.is_open() ) {
+        return res;
+    }
+    const PositionStats& stats = explorer_stats();
+    // occurrences also count games that ended here, shares are of the moves played
+    uint64_t played = 0;
+    for(auto iter=stats.moves.begin(); iter!=stats.moves.end(); iter++) {
+        played += iter->count;
+    }
+    for(auto iter=stats.moves.begin(); iter!=stats.moves.end(); iter++) {
+        QVariantMap item;
+        item["move"] = square_name(unpacked_src(iter->move)) + "-" + square_name(unpacked_dst(iter->move));
+        item["count"] = static_cast<qulonglong>(iter->count);
+        item["percent"] = qRound(100.0 * iter->count / played);
+        res.append(item);
+    }
+    return res;
+}
+
+int ChessFieldModel::explorer_games() const
+{
+    if( !m_position_index.is_open() ) {
+        return 0;
+    }
+    return explorer_stats().games;
+}
+
+const PositionStats& ChessFieldModel::explorer_stats() const
+{
+    const quint64 hash = m_chess_board.get_hash();
+    auto iter = m_explorer_cache.find(hash);
+    if( iter == m_explorer_cache.end() ) {
+        if( m_explorer_cache.size() >= EXPLORER_CACHE_POSITIONS ) {
+            m_explorer_cache.clear();
+        }
+        iter = m_explorer_cache.insert(hash, m_position_index.query(hash));
+    }
+    return iter.value();
+}
 
 bool ChessFieldModel::undo()
 {
+    if( m_file_busy ) {
+        return false;
+    }
+    stop_engine_game();
     auto res = m_chess_board.undo();
     if( !res ) {
         return false;
     }
+    append_journal(GameJournal::UNDO, res);
     update_cells(res);
     return true;
 }
 
 bool ChessFieldModel::redo()
 {
+    if( m_file_busy ) {
+        return false;
+    }
+    stop_engine_game();
     auto res = m_chess_board.redo();
     if( !res ) {
         return false;
     }
+    append_journal(GameJournal::REDO, res);
     update_cells(res);
     return true;
 }
 
+bool ChessFieldModel::next_variation()
+{
+    return select_variation(true);
+}
+
+bool ChessFieldModel::prev_variation()
+{
+    return select_variation(false);
+}
+
+bool ChessFieldModel::select_variation(bool next)
+{
+    // no last move to replace at the start position
+    if( m_file_busy || m_chess_board.get_ply() == 0 ) {
+        return false;
+    }
+    stop_engine_game();
+    const PackedMove replaced = m_chess_board.get_current_line().back();
+    bool res = next ? m_chess_board.next_variation() : m_chess_board.prev_variation();
+    if( !res ) {
+        return false;
+    }
+    append_journal(GameJournal::UNDO, replaced);
+    append_journal(GameJournal::MOVE, m_chess_board.get_current_line().back());
+    update_model();
+    return true;
+}
+
+QVariantList ChessFieldModel::instrumentation() const
+{
+    QVariantList res;
+    std::vector<ProbeStats> stats = Instrumentation::snapshot();
+    for(auto iter=stats.begin(); iter!=stats.end(); iter++) {
+        QVariantMap item;
+        item["name"] = QString(iter->name);
+        item["count"] = static_cast<qulonglong>(iter->count);
+        item["total_ms"] = iter->total_ns / 1e6;
+        item["avg_us"] = iter->count ? iter->total_ns / 1e3 / iter->count : 0.0;
+        res.append(item);
+    }
+    return res;
+}
+
+bool ChessFieldModel::instrumentation_enabled() const
+{
+    return Instrumentation::is_enabled();
+}
+
+void ChessFieldModel::set_tracing(bool on)
+{
+    Instrumentation::set_tracing(on);
+}
+
+bool ChessFieldModel::export_trace(QUrl file)
+{
+    std::string fname = to_local_file(file);
+    return !fname.empty() && Instrumentation::export_trace(fname);
+}
+
+QString ChessFieldModel::draw_reason() const
+{
+    switch(m_chess_board.get_draw_reason()) {
+        case ChessBoard::DrawReason::REPETITION:
+            return "threefold repetition";
+        case ChessBoard::DrawReason::FIFTY_MOVES:
+            return "fifty-move rule";
+        case ChessBoard::DrawReason::INSUFFICIENT_MATERIAL:
+            return "insufficient material";
+        default:
+            return "";
+    }
+}
+
 QVariantMap ChessFieldModel::get(int row) const
 {
     QVariantMap res;
     if( row >= 0 && row < m_list.count() ) {
         res["cell_color"] = m_list[row].first;
-        res["image_path"] = m_list[row].second;
+        res["piece"] = m_list[row].second;
     }
     return res;
 }
@@ -146,7 +412,7 @@ QVariant ChessFieldModel::data(const QModelIndex &index, int role) const
     switch(role) {
         case CELL_COLOR:
             return QVariant(m_list[index.row()].first);
-        case IMAGE_PATH:
+        case PIECE:
             return QVariant(m_list[index.row()].second);
         default:
             return QVariant();
@@ -163,8 +429,8 @@ bool ChessFieldModel::setData(const QModelIndex &index, const QVariant &value, i
             m_list[index.row()].first = value.toString();
             emit dataChanged(index, index);
             return true;
-        case IMAGE_PATH:
-            m_list[index.row()].second = value.toString();
+        case PIECE:
+            m_list[index.row()].second = value.toInt();
             emit dataChanged(index, index);
             return true;
         default:
@@ -174,25 +440,372 @@ bool ChessFieldModel::setData(const QModelIndex &index, const QVariant &value, i
 
 void ChessFieldModel::update_cells(std::shared_ptr<ChessMove> move)
 {
-    QVector<int> roles(1, IMAGE_PATH);
+    PROBE_SCOPE(Probe::UPDATE_CELLS);
+    QVector<int> roles(1, PIECE);
     const int count = move->changed_cells_count();
     auto cells = move->get_changed_cells();
 
     for(int i=0; i<count; i++) {
         ChessPiece cp = cells[i].second;
         int ind = from_board_to_list(cells[i].first);
-        m_list[ind].second = m_chess_piece_images[to_int(cp)];
+        m_list[ind].second = to_int(cp);
         emit dataChanged(index(ind), index(ind), roles);
     }
+    notify_board_changed();
 }
 
 void ChessFieldModel::update_model()
 {
-    QList<std::pair<QString,QString> >::iterator iter = m_list.begin();
+    PROBE_SCOPE(Probe::UPDATE_MODEL);
+    refresh_pieces();
+    QVector<int> roles(1, PIECE);
+    emit dataChanged(index(0), index(m_list.size()-1), roles);
+    notify_board_changed();
+}
+
+void ChessFieldModel::refresh_pieces()
+{
+    QList<std::pair<QString,int> >::iterator iter = m_list.begin();
     for(int i=0; iter != m_list.end(); i++, iter++) {
         ChessPiece cp = m_chess_board.get_board_piece(7 - i / 8, i % 8);
-        iter->second = m_chess_piece_images[to_int(cp)];
+        iter->second = to_int(cp);
     }
-    QVector<int> roles(1, IMAGE_PATH);
-    emit dataChanged(index(0), index(m_list.size()-1), roles);
+}
+
+void ChessFieldModel::notify_board_changed()
+{
+    emit board_changed(m_chess_board.take_dirty_squares());
+    emit game_state_changed();
+    if( m_analysis_lines > 0 ) {
+        restart_analysis();
+    }
+}
+
+/*
+ *  Background analysis
+ */
+
+void ChessFieldModel::start_analysis(int lines)
+{
+    m_analysis_lines = std::max(lines, 1);
+    restart_analysis();
+}
+
+void ChessFieldModel::stop_analysis()
+{
+    m_analysis_lines = 0;
+    m_analyzer.stop();
+}
+
+void ChessFieldModel::restart_analysis()
+{
+    m_analysis.clear();
+    m_analysis_depth = 0;
+
+    Position pos;
+    pos.set_board(m_chess_board);
+    m_analysis_hash = pos.get_hash();
+    if( !pos.has_king(ChessBoard::WHITE) || !pos.has_king(ChessBoard::BLACK) ) {
+        m_analyzer.stop();
+        emit analysis_changed();
+        return;
+    }
+
+    // analysed ahead or earlier in this session, otherwise a line of an earlier session
+    SearchResult known;
+    if( m_analyzer.lookup(m_analysis_hash, known) || m_analysis_cache.lookup(m_analysis_hash, known) ) {
+        for(auto line=known.lines.begin(); line!=known.lines.end(); line++) {
+            m_analysis.append(analysis_item(*line, pos.get_side()));
+        }
+        m_analysis_depth = known.depth;
+    }
+
+    std::vector<Position> upcoming;
+    const std::vector<PackedMove> moves = m_chess_board.get_upcoming_moves(ANALYSIS_LOOKAHEAD_PLIES);
+    Position next(pos);
+    for(auto move=moves.begin(); move!=moves.end() && next.is_legal(*move); move++) {
+        next.make_move(*move);
+        if( !next.has_king(ChessBoard::WHITE) || !next.has_king(ChessBoard::BLACK) ) {
+            break;
+        }
+        upcoming.push_back(next);
+    }
+    m_analyzer.set_positions(pos, upcoming, m_analysis_lines);
+    emit analysis_changed();
+}
+
+void ChessFieldModel::on_analyzed(const Position& pos, const SearchResult& result)
+{
+    m_analysis_cache.store(pos.get_hash(), result);
+    QVariantList lines;
+    for(auto line=result.lines.begin(); line!=result.lines.end(); line++) {
+        lines.append(analysis_item(*line, pos.get_side()));
+    }
+    QMetaObject::invokeMethod(this, "on_analysis_progress", Qt::QueuedConnection,
+                              Q_ARG(QVariantList, lines), Q_ARG(int, result.depth),
+                              Q_ARG(quint64, pos.get_hash()));
+}
+
+void ChessFieldModel::on_analysis_progress(QVariantList lines, int depth, quint64 hash)
+{
+    // a cached line stays until the search gets as deep
+    if( hash != m_analysis_hash || m_analysis_lines == 0 || depth < m_analysis_depth ) {
+        return;
+    }
+    m_analysis = lines;
+    m_analysis_depth = depth;
+    emit analysis_changed();
+}
+
+/*
+ *  Engine game
+ */
+
+void ChessFieldModel::start_engine_game(int engine_side, int minutes, int increment_seconds, bool ponder)
+{
+    if( m_file_busy || (engine_side != ChessBoard::WHITE && engine_side != ChessBoard::BLACK) ) {
+        return;
+    }
+    stop_engine_game();
+    m_engine_side = engine_side;
+    m_clock_ms[ChessBoard::WHITE] = m_clock_ms[ChessBoard::BLACK] = std::max(minutes, 1) * 60000LL;
+    m_increment_ms = std::max(increment_seconds, 0) * 1000LL;
+    m_engine.set_pondering(ponder);
+    m_turn_timer.start();
+    m_clock_timer.start();
+    emit engine_changed();
+    emit clock_changed();
+    check_engine_game();
+    engine_think();
+}
+
+void ChessFieldModel::stop_engine_game()
+{
+    if( m_engine_side < 0 ) {
+        return;
+    }
+    m_engine.stop();
+    m_engine_side = -1;
+    m_clock_timer.stop();
+    emit engine_changed();
+    emit clock_changed();
+}
+
+void ChessFieldModel::finish_engine_game(const QString& result)
+{
+    stop_engine_game();
+    emit engine_game_finished(result);
+}
+
+void ChessFieldModel::engine_think()
+{
+    if( m_engine_side != m_chess_board.get_current_side() ) {
+        return;
+    }
+    Position pos;
+    pos.set_board(m_chess_board);
+    TimeControl clock;
+    clock.remaining_ms = clock_left(m_engine_side);
+    clock.increment_ms = m_increment_ms;
+    m_engine.play(pos, clock);
+}
+
+void ChessFieldModel::switch_clock()
+{
+    const int moved = 1 - m_chess_board.get_current_side();
+    m_clock_ms[moved] += m_increment_ms - m_turn_timer.restart();
+    emit clock_changed();
+}
+
+void ChessFieldModel::check_engine_game()
+{
+    const int side = m_chess_board.get_current_side();
+    Position pos;
+    pos.set_board(m_chess_board);
+    if( !pos.has_king(side) ) {
+        finish_engine_game(side == ChessBoard::WHITE ? "Black wins" : "White wins");
+    } else if( !draw_reason().isEmpty() ) {
+        finish_engine_game("Draw: " + draw_reason());
+    }
+}
+
+int64_t ChessFieldModel::clock_left(int side) const
+{
+    int64_t res = m_clock_ms[side];
+    if( m_engine_side >= 0 && side == m_chess_board.get_current_side() ) {
+        res -= m_turn_timer.elapsed();
+    }
+    return std::max<int64_t>(res, 0);
+}
+
+QString ChessFieldModel::clock_text(int side) const
+{
+    if( m_engine_side < 0 ) {
+        return QString();
+    }
+    const int64_t secs = (clock_left(side) + 999) / 1000;
+    return QString("%1:%2").arg(secs / 60).arg(secs % 60, 2, 10, QChar('0'));
+}
+
+void ChessFieldModel::on_clock_tick()
+{
+    emit clock_changed();
+    const int side = m_chess_board.get_current_side();
+    if( m_engine_side >= 0 && clock_left(side) == 0 ) {
+        finish_engine_game(side == ChessBoard::WHITE ? "Black wins on time" : "White wins on time");
+    }
+}
+
+void ChessFieldModel::on_engine_move(quint32 move, quint64 hash)
+{
+    if( m_file_busy || m_engine_side != m_chess_board.get_current_side() || hash != m_chess_board.get_hash() ) {
+        return;
+    }
+    auto res = (move == NO_MOVE) ? std::shared_ptr<ChessMove>() :
+                                   m_chess_board.make_move(unpacked_src(move), unpacked_dst(move));
+    if( !res ) {
+        finish_engine_game("Engine has no move");
+        return;
+    }
+    append_journal(GameJournal::MOVE, res);
+    update_cells(res);
+    switch_clock();
+    check_engine_game();
+}
+
+/*
+ *  Background load & save
+ */
+
+bool ChessFieldModel::save_game(QUrl file)
+{
+    std::string fname = to_local_file(file);
+    if( m_file_busy || fname.empty() ) {
+        return false;
+    }
+    // engine moves would change the board & journal under the save thread
+    stop_engine_game();
+    finish_compaction();
+    start_file_task(fname, -1);
+    // board & journal are only read by the GUI thread until on_file_task_done
+    m_file_thread = std::thread([this, fname]() {
+        PROBE_SCOPE(Probe::FILE_SAVE);
+        // saving is a compaction of the journal: game is rewritten, journal starts from scratch
+        bool ok = GameJournal::compact(fname, fname + JOURNAL_SUFFIX, m_chess_board, m_journal);
+        QMetaObject::invokeMethod(this, "on_file_task_done", Qt::QueuedConnection,
+                                  Q_ARG(bool, ok), Q_ARG(bool, false));
+    });
+    return true;
+}
+
+bool ChessFieldModel::load_game(QUrl file)
+{
+    std::string fname = to_local_file(file);
+    if( m_file_busy || fname.empty() ) {
+        return false;
+    }
+    stop_engine_game();
+    start_file_task(fname, 0);
+    m_file_thread = std::thread([this, fname]() {
+        bool ok = load_file(fname);
+        QMetaObject::invokeMethod(this, "on_file_task_done", Qt::QueuedConnection,
+                                  Q_ARG(bool, ok), Q_ARG(bool, true));
+    });
+    return true;
+}
+
+void ChessFieldModel::cancel_file_task()
+{
+    m_file_cancel.store(true);
+}
+
+void ChessFieldModel::start_file_task(const std::string& fname, double progress)
+{
+    m_file_task_name = fname;
+    m_file_cancel.store(false);
+    m_file_busy = true;
+    m_file_progress = progress;
+    emit file_task_changed();
+}
+
+bool ChessFieldModel::load_file(const std::string& fname)
+{
+    PROBE_SCOPE(Probe::FILE_LOAD);
+    std::ifstream in(fname.c_str());
+    if( !in ) {
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    const uint64_t size = static_cast<uint64_t>(in.tellg());
+    in.seekg(0, std::ios::beg);
+
+    std::unique_ptr<ChessBoard> board(new ChessBoard());
+    int percent = 0;
+    bool ret = board->load_game(in, [this, &in, size, &percent]() {
+        if( m_file_cancel.load() ) {
+            return false;
+        }
+        const std::streamoff pos = in.tellg();
+        const int now = pos > 0 && size > 0 ? static_cast<int>(100 * pos / size) : percent;
+        if( now != percent ) {
+            percent = now;
+            QMetaObject::invokeMethod(this, "on_file_progress", Qt::QueuedConnection,
+                                      Q_ARG(double, percent / 100.0));
+        }
+        return true;
+    });
+    in.close();
+    if( !ret || m_file_cancel.load() ) {
+        return false;
+    }
+    // moves made after the last save are recovered from the journal,
+    // without a journal the game is loaded anyway but isn't journaled
+    const std::string journal = fname + JOURNAL_SUFFIX;
+    if( !m_loaded_journal.recover(journal, board->get_hash(), size, *board) ) {
+        m_loaded_journal.create(journal, board->get_hash(), size);
+    }
+    m_loaded_board = std::move(board);
+    return true;
+}
+
+void ChessFieldModel::on_file_progress(double progress)
+{
+    if( !m_file_busy ) {
+        return;
+    }
+    m_file_progress = progress;
+    emit file_task_changed();
+}
+
+void ChessFieldModel::on_file_task_done(bool ok, bool loading)
+{
+    m_file_thread.join();
+    if( loading ) {
+        if( ok && !m_file_cancel.load() ) {
+            close_journal();
+            // whole board changes at once: one reset instead of a signal per square
+            beginResetModel();
+            m_chess_board = std::move(*m_loaded_board);
+            refresh_pieces();
+            endResetModel();
+            m_journal.swap(m_loaded_journal);
+            if( m_journal.is_open() ) {
+                m_save_file = m_file_task_name;
+            }
+        } else {
+            ok = false;
+        }
+        m_loaded_board.reset();
+        m_loaded_journal.close();
+    } else if( ok ) {
+        m_save_file = m_file_task_name;
+    }
+
+    m_file_busy = false;
+    m_file_progress = 0;
+    emit file_task_changed();
+    if( loading && ok ) {
+        notify_board_changed();
+    }
+    emit file_task_finished(ok);
 }
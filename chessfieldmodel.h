@@ -4,21 +4,58 @@
 #include <QAbstractListModel>
 #include <QVector>
 #include <QUrl>
+#include <QVariantList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
 
 #include <utility>
+#include <thread>
+#include <memory>
+#include <atomic>
 #include "chessboard.h"
 #include "chesspiecemove.h"
+#include "positionindex.h"
+#include "gamejournal.h"
+#include "search.h"
+#include "analysiscache.h"
+#include "preanalyzer.h"
+#include "engineplayer.h"
 
 class ChessFieldModel : public QAbstractListModel
 {
     Q_OBJECT
+    Q_PROPERTY(QString draw_reason READ draw_reason NOTIFY game_state_changed)
+    Q_PROPERTY(int halfmove_clock READ halfmove_clock NOTIFY game_state_changed)
+    Q_PROPERTY(QVariantList explorer READ explorer NOTIFY game_state_changed)
+    Q_PROPERTY(int explorer_games READ explorer_games NOTIFY game_state_changed)
+    Q_PROPERTY(int variations_count READ variations_count NOTIFY game_state_changed)
+    Q_PROPERTY(int variation_index READ variation_index NOTIFY game_state_changed)
+    //probes snapshot: {name, count, total_ms, avg_us}, empty unless built with CONFIG+=instrumentation
+    Q_PROPERTY(QVariantList instrumentation READ instrumentation NOTIFY game_state_changed)
+    Q_PROPERTY(bool instrumentation_enabled READ instrumentation_enabled CONSTANT)
+    //best moves of current position: {move, score, pv}, best first, grows deeper while analysis runs,
+    //positions redo leads to are analysed ahead, so stepping through a game shows them at once
+    Q_PROPERTY(QVariantList analysis READ analysis NOTIFY analysis_changed)
+    Q_PROPERTY(int analysis_depth READ analysis_depth NOTIFY analysis_changed)
+    //load or save runs in background, the board can't be changed until it finishes
+    Q_PROPERTY(bool file_busy READ file_busy NOTIFY file_task_changed)
+    //0..1 while loading, -1 while saving
+    Q_PROPERTY(double file_progress READ file_progress NOTIFY file_task_changed)
+    //game against the engine on the clock: side the engine plays, -1 if there is no such game
+    Q_PROPERTY(int engine_side READ engine_side NOTIFY engine_changed)
+    //remaining time, "m:ss"
+    Q_PROPERTY(QString white_clock READ white_clock NOTIFY clock_changed)
+    Q_PROPERTY(QString black_clock READ black_clock NOTIFY clock_changed)
 public:
     enum Roles {
         CELL_COLOR = Qt::UserRole+1,
-        IMAGE_PATH
+        //ChessPiece as int, images are served by PieceImageProvider as "image://pieces/<piece>"
+        PIECE
     };
-    explicit ChessFieldModel(QObject *parent = 0);
-    virtual ~ChessFieldModel(){}
+    //analysis_cache - file of the persistent analysis cache, empty - no cache
+    explicit ChessFieldModel(const std::string& analysis_cache = std::string(), QObject *parent = 0);
+    virtual ~ChessFieldModel();
 
     Q_INVOKABLE QVariantMap get(int row) const;
     //Q_INVOKABLE void setImagePath(int row, const QVariant& val);
@@ -26,11 +63,45 @@ public:
     Q_INVOKABLE void clean_board();
     Q_INVOKABLE void reset_board();
     Q_INVOKABLE void make_move(int src_cell, int dest_cell);
+    //both start a background task & return false if it can't be started, result comes with file_task_finished
     Q_INVOKABLE bool load_game(QUrl file);
     Q_INVOKABLE bool save_game(QUrl file);
+    //loading is dropped & the current game stays, saving is atomic and always completes
+    Q_INVOKABLE void cancel_file_task();
     Q_INVOKABLE bool undo();
     Q_INVOKABLE bool redo();
+    Q_INVOKABLE bool next_variation();
+    Q_INVOKABLE bool prev_variation();
+    Q_INVOKABLE bool open_position_index(QUrl file);
+    Q_INVOKABLE void set_tracing(bool on);
+    Q_INVOKABLE bool export_trace(QUrl file);
+    //multi-PV analysis in background, follows the current position until stopped
+    Q_INVOKABLE void start_analysis(int lines);
+    Q_INVOKABLE void stop_analysis();
+    //engine plays engine_side from the current position, ponder - it thinks on the opponent's time too
+    //the game stops on any board change other than a move, result comes with engine_game_finished
+    Q_INVOKABLE void start_engine_game(int engine_side, int minutes, int increment_seconds, bool ponder);
+    Q_INVOKABLE void stop_engine_game();
 
+    //empty string if game isn't drawn
+    QString draw_reason() const;
+    int halfmove_clock() const                                                          {   return m_chess_board.get_halfmove_clock();   }
+    //moves played from current position in indexed games: {move, count, percent}
+    QVariantList explorer() const;
+    int explorer_games() const;
+    int variations_count() const                                                        {   return m_chess_board.get_variations_count();   }
+    int variation_index() const                                                         {   return m_chess_board.get_variation_index();   }
+    QVariantList instrumentation() const;
+    bool instrumentation_enabled() const;
+    QVariantList analysis() const                                                       {   return m_analysis;   }
+    int analysis_depth() const                                                          {   return m_analysis_depth;   }
+    bool file_busy() const                                                              {   return m_file_busy;   }
+    double file_progress() const                                                        {   return m_file_progress;   }
+    int engine_side() const                                                             {   return m_engine_side;   }
+    QString white_clock() const                                                         {   return clock_text(ChessBoard::WHITE);   }
+    QString black_clock() const                                                         {   return clock_text(ChessBoard::BLACK);   }
+
+    const ChessBoard& get_board() const                                                 {   return m_chess_board;   }
 
     virtual QHash<int,QByteArray> roleNames() const                                     {   return m_role_names;    }
     virtual int rowCount(const QModelIndex &parent = QModelIndex()) const               {    Q_UNUSED(parent); return m_list.count();   }
@@ -41,18 +112,111 @@ public:
 private:
     void update_cells(std::shared_ptr<ChessMove> move);
     void update_model();
+    //copies board pieces into the list without notifications
+    void refresh_pieces();
+    void notify_board_changed();
+
+    //runs in the file thread, result is taken over by on_file_task_done
+    bool load_file(const std::string& fname);
+    void start_file_task(const std::string& fname, double progress);
+
+    //every action is journaled next to the file the game was loaded from/saved to
+    void append_journal(GameJournal::Action action, const std::shared_ptr<ChessMove>& move);
+    void append_journal(GameJournal::Action action, PackedMove move);
+    bool select_variation(bool next);
+    void close_journal();
+    //journal is compacted on its own thread, actions in the meantime go to the old journal
+    //& are replayed into the new one
+    void start_compaction();
+    //waits for the compaction thread, switches to the new journal if it succeeded
+    void finish_compaction();
+
+    //explorer stats of the current position, queried once per position
+    const PositionStats& explorer_stats() const;
+
+    void restart_analysis();
+    //worker thread, shows results of the current position
+    void on_analyzed(const Position& pos, const SearchResult& result);
+
+    //asks the engine for a move if it is its turn
+    void engine_think();
+    //charges the time of the move just made to the side that made it
+    void switch_clock();
+    //ends the engine game on a taken king, a draw or a fallen flag
+    void check_engine_game();
+    void finish_engine_game(const QString& result);
+    int64_t clock_left(int side) const;
+    QString clock_text(int side) const;
 
 
 signals:
+    void game_state_changed();
+    //emitted after every board update, bit r*8+c of dirty_squares is set for every changed square
+    void board_changed(quint64 dirty_squares);
+    void analysis_changed();
+    void file_task_changed();
+    void file_task_finished(bool ok);
+    void engine_changed();
+    void clock_changed();
+    void engine_game_finished(QString result);
+    //actions may not reach the disk until the game is saved
+    void journal_failed();
 
 public slots:
 
+private slots:
+    //queued from the analysis thread, results of other positions are dropped
+    void on_analysis_progress(QVariantList lines, int depth, quint64 hash);
+    void on_file_progress(double progress);
+    void on_file_task_done(bool ok, bool loading);
+    //queued from the engine thread, a move for another position is dropped
+    void on_engine_move(quint32 move, quint64 hash);
+    void on_clock_tick();
+    //queued from the compaction thread
+    void on_compaction_done();
+
 private:
-    QVector<QString> m_chess_piece_images;
     Q_DISABLE_COPY(ChessFieldModel)
-    QList<std::pair<QString, QString> > m_list;
+    QList<std::pair<QString, int> > m_list;
     QHash<int,QByteArray> m_role_names;
     ChessBoard m_chess_board;
+    PositionIndex m_position_index;
+    //index is read only once opened, its stats are kept until it is reopened
+    mutable QHash<quint64, PositionStats> m_explorer_cache;
+
+    std::string m_save_file;
+    GameJournal m_journal;
+    std::thread m_compact_thread;
+    bool m_compacting;
+    std::vector<std::pair<GameJournal::Action, PackedMove> > m_compact_pending;
+    //written by the compaction thread only, read after it is joined
+    GameJournal m_compacted_journal;
+    bool m_compact_ok;
+    bool m_compact_replaced;
+
+    //results of earlier sessions, shown at once & extended by every completed iteration
+    AnalysisCache m_analysis_cache;
+    PreAnalyzer m_analyzer;
+    int m_analysis_lines;               //0 if analysis is off
+    uint64_t m_analysis_hash;
+    QVariantList m_analysis;
+    int m_analysis_depth;
+
+    EnginePlayer m_engine;
+    int m_engine_side;                  //-1 if there is no engine game
+    int64_t m_clock_ms[2];              //at the start of the current turn
+    int64_t m_increment_ms;
+    QElapsedTimer m_turn_timer;
+    QTimer m_clock_timer;
+
+    std::thread m_file_thread;
+    std::atomic<bool> m_file_cancel;
+    bool m_file_busy;
+    double m_file_progress;
+    std::string m_file_task_name;
+    //written by the load thread only, read after it is joined
+    std::unique_ptr<ChessBoard> m_loaded_board;
+    GameJournal m_loaded_journal;
 };
 
 
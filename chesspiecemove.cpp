@@ -1,7 +1,9 @@
 #include "chesspiecemove.h"
+#include "zobrist.h"
 
 #include <sstream>
 #include <unordered_map>
+#include <algorithm>
 
 using std::pair;
 using std::make_pair;
@@ -17,8 +19,58 @@ using std::unordered_map;
  */
 
 BoardMgr::BoardMgr(ChessPiece (&chess_board)[8][8], bool (&fst_move_flags)[8][8]):
-    m_chess_board(chess_board), m_1st_move_flags(fst_move_flags)
-{}
+    m_chess_board(chess_board), m_1st_move_flags(fst_move_flags), m_hash(0), m_pawn_hash(0), m_dirty(~uint64_t(0))
+{
+    std::fill_n(m_piece_counts, to_int(ChessPiece::PIECES_COUNT), 0);
+}
+
+void BoardMgr::sync()
+{
+    m_hash = 0;
+    m_pawn_hash = 0;
+    m_dirty = ~uint64_t(0);
+    std::fill_n(m_piece_counts, to_int(ChessPiece::PIECES_COUNT), 0);
+    for(int r=0; r<ROWS; r++) {
+        for(int c=0; c<COLS; c++) {
+            int cp = to_int(m_chess_board[r][c]);
+            m_hash ^= Zobrist::piece(cp, r, c);
+            if( is_pawn(m_chess_board[r][c]) ) {
+                m_pawn_hash ^= Zobrist::piece(cp, r, c);
+            }
+            m_piece_counts[cp]++;
+
+            int ind = Zobrist::castling_square(r, c);
+            if( ind >= 0 && m_1st_move_flags[r][c] ) {
+                m_hash ^= Zobrist::castling(ind);
+            }
+        }
+    }
+}
+
+void BoardMgr::set_piece(int r, int c, ChessPiece cp)
+{
+    int old = to_int(m_chess_board[r][c]);
+    m_hash ^= Zobrist::piece(old, r, c) ^ Zobrist::piece(to_int(cp), r, c);
+    if( is_pawn(m_chess_board[r][c]) ) {
+        m_pawn_hash ^= Zobrist::piece(old, r, c);
+    }
+    if( is_pawn(cp) ) {
+        m_pawn_hash ^= Zobrist::piece(to_int(cp), r, c);
+    }
+    m_piece_counts[old]--;
+    m_piece_counts[to_int(cp)]++;
+    m_chess_board[r][c] = cp;
+    m_dirty |= uint64_t(1) << (r*COLS + c);
+}
+
+void BoardMgr::set_1st_move(int r, int c, bool flag)
+{
+    int ind = Zobrist::castling_square(r, c);
+    if( ind >= 0 && m_1st_move_flags[r][c] != flag ) {
+        m_hash ^= Zobrist::castling(ind);
+    }
+    m_1st_move_flags[r][c] = flag;
+}
 
 bool BoardMgr::is_1st_move(const vec2& pos) const
 {
@@ -27,31 +79,32 @@ bool BoardMgr::is_1st_move(const vec2& pos) const
 
 void BoardMgr::change_piece_pos(const vec2& from, const vec2& to)
 {
-    m_chess_board[to[0]][to[1]] = m_chess_board[from[0]][from[1]];
-    m_chess_board[from[0]][from[1]] = ChessPiece::NONE;
+    set_piece(to[0], to[1], m_chess_board[from[0]][from[1]]);
+    set_piece(from[0], from[1], ChessPiece::NONE);
 }
 
 void BoardMgr::move(const vec2& from, const vec2& to)
 {
-    m_chess_board[to[0]][to[1]] = m_chess_board[from[0]][from[1]];
-    m_chess_board[from[0]][from[1]] = ChessPiece::NONE;
+    set_piece(to[0], to[1], m_chess_board[from[0]][from[1]]);
+    set_piece(from[0], from[1], ChessPiece::NONE);
 
-    m_1st_move_flags[from[0]][from[1]] = m_1st_move_flags[to[0]][to[1]] = false;
+    set_1st_move(from[0], from[1], false);
+    set_1st_move(to[0], to[1], false);
 }
 
 void BoardMgr::promote(const vec2& pos, ChessPiece cp)
 {
-    m_chess_board[pos[0]][pos[1]] = cp;
+    set_piece(pos[0], pos[1], cp);
 }
 
 void BoardMgr::undo_move(const vec2& from, ChessPiece src_piece, bool src_1st_move,
                          const vec2& to, ChessPiece dst_piece, bool dst_1st_move)
 {
-    m_chess_board[from[0]][from[1]] = src_piece;
-    m_chess_board[to[0]][to[1]] = dst_piece;
+    set_piece(from[0], from[1], src_piece);
+    set_piece(to[0], to[1], dst_piece);
 
-    m_1st_move_flags[from[0]][from[1]] = src_1st_move;
-    m_1st_move_flags[to[0]][to[1]] = dst_1st_move;
+    set_1st_move(from[0], from[1], src_1st_move);
+    set_1st_move(to[0], to[1], dst_1st_move);
 }
 
 /*
@@ -111,6 +164,12 @@ bool SimpleMove::undo(BoardMgr& board)
     return true;
 }
 
+bool SimpleMove::is_irreversible() const
+{
+    return m_chess_pieces.first == ChessPiece::WT_PAWN || m_chess_pieces.first == ChessPiece::BK_PAWN ||
+           m_chess_pieces.second != ChessPiece::NONE;
+}
+
 /*
  * PawnMoveWithPromotion implementation
  */
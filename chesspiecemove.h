@@ -6,6 +6,7 @@
 #include <utility>
 #include <memory>
 #include <istream>
+#include <cstdint>
 
 template<class T1> inline void UNUSED(T1) {}
 template<class T1, class T2> inline void UNUSED(T1,T2) {}
@@ -22,6 +23,17 @@ private:
 inline vec2 make_vec2(int v1, int v2)       {   return vec2(v1,v2);  }
 inline vec2 make_vec2(std::pair<int,int> v) {   return vec2(v.first,v.second);  }
 
+//move packed to 12 bits: src square * 64 + dst square, square = row * 8 + column
+typedef uint16_t PackedMove;
+static const PackedMove NO_MOVE = 0xFFFF;
+
+inline PackedMove pack_move(const vec2& src, const vec2& dst)
+{
+    return static_cast<PackedMove>((src[0]*8 + src[1])*64 + dst[0]*8 + dst[1]);
+}
+inline vec2 unpacked_src(PackedMove m)      {   return vec2((m >> 9) & 7, (m >> 6) & 7);  }
+inline vec2 unpacked_dst(PackedMove m)      {   return vec2((m >> 3) & 7, m & 7);  }
+
 
 /*
  *  ChessPiece
@@ -47,6 +59,7 @@ enum class ChessPiece
 };
 
 inline int to_int(ChessPiece cp)                {   return static_cast<int>(cp);    }
+inline bool is_pawn(ChessPiece cp)              {   return cp == ChessPiece::WT_PAWN || cp == ChessPiece::BK_PAWN;    }
 
 /*
  *   BoardMgr
@@ -60,6 +73,9 @@ public:
 
     BoardMgr(ChessPiece (&chess_board)[ROWS][COLS], bool (&fst_move_flags)[ROWS][COLS]);
 
+    //recalculates hash & piece counts after the board was changed directly
+    void sync();
+
     bool is_1st_move(const vec2& pos) const;
 
     void change_piece_pos(const vec2& from, const vec2& to);
@@ -72,9 +88,26 @@ public:
 
     ChessPiece get(int x, int y) const                            {    return m_chess_board[x][y];   }
     bool is_king_under_attack() const                             {    return false;   }
+
+    //hash of pieces & castling flags, side to move is handled by ChessBoard
+    uint64_t get_hash() const                                     {    return m_hash;   }
+    //hash of pawns only, keys for pawn structure caches
+    uint64_t get_pawn_hash() const                                {    return m_pawn_hash;   }
+    int get_piece_count(ChessPiece cp) const                      {    return m_piece_counts[to_int(cp)];   }
+
+    //bit r*COLS+c is set for every square whose piece changed since the previous call
+    uint64_t take_dirty_squares()                                 {    uint64_t res = m_dirty; m_dirty = 0; return res;   }
 private:
+    void set_piece(int r, int c, ChessPiece cp);
+    void set_1st_move(int r, int c, bool flag);
+
     ChessPiece (&m_chess_board)[8][8];
     bool (&m_1st_move_flags)[8][8];
+
+    uint64_t m_hash;
+    uint64_t m_pawn_hash;
+    uint64_t m_dirty;
+    int m_piece_counts[static_cast<int>(ChessPiece::PIECES_COUNT)];
 };
 
 
@@ -103,6 +136,9 @@ public:
     virtual const vec2& get_src_pos() const = 0;
     virtual const vec2& get_dst_pos() const = 0;
 
+    //@ret true for pawn moves & captures - they reset the fifty-move clock
+    virtual bool is_irreversible() const                                  {   return true;    }
+
     virtual ~ChessMove(){}
 protected:
     bool m_is_applied;
@@ -126,6 +162,8 @@ public:
 
     virtual const vec2& get_src_pos() const       {   return m_changed_cells[0].first;   }
     virtual const vec2& get_dst_pos() const       {   return m_changed_cells[1].first;   }
+
+    virtual bool is_irreversible() const;
 protected:
 
     //contains (src, dst) chess piece pair
@@ -165,6 +203,8 @@ public:
 
     virtual const vec2& get_src_pos() const       {   return m_changed_cells[0].first;   }
     virtual const vec2& get_dst_pos() const       {   return m_changed_cells[1].first;   }
+
+    virtual bool is_irreversible() const          {   return false;   }
 public:
     //contains (king, castle) chess piece pair
     const std::pair<ChessPiece,ChessPiece> m_chess_pieces;
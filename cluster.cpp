@@ -0,0 +1,486 @@
+#include "cluster.h"
+
+#include <sstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <unistd.h>
+
+/*
+ *  Auxiliary functions
+ */
+
+static const char UNIX_PREFIX[] = "unix:";
+
+static bool is_unix_address(const std::string& address)
+{
+    return address.compare(0, sizeof(UNIX_PREFIX) - 1, UNIX_PREFIX) == 0;
+}
+
+static bool unix_address(const std::string& address, sockaddr_un& addr)
+{
+    const std::string path = address.substr(sizeof(UNIX_PREFIX) - 1);
+    if( path.empty() || path.size() >= sizeof(addr.sun_path) ) {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    return true;
+}
+
+//"host:port", empty host or "*" - any interface
+static addrinfo* tcp_address(const std::string& address, bool passive)
+{
+    const size_t colon = address.rfind(':');
+    if( colon == std::string::npos ) {
+        return NULL;
+    }
+    std::string host = address.substr(0, colon);
+    const std::string port = address.substr(colon + 1);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* res = NULL;
+    const char* node = (host.empty() || host == "*") ? NULL : host.c_str();
+    if( getaddrinfo(node, port.c_str(), &hints, &res) != 0 ) {
+        return NULL;
+    }
+    return res;
+}
+
+//mate distances grow by the ply from the root to the child
+static int score_from_child(int score)
+{
+    score = -score;
+    if( score > MATE_BOUND ) {
+        score--;
+    } else if( score < -MATE_BOUND ) {
+        score++;
+    }
+    return score;
+}
+
+/*
+ *  LineChannel implementation
+ */
+
+LineChannel::LineChannel(int fd):
+    m_fd(fd)
+{}
+
+LineChannel::~LineChannel()
+{
+    close();
+}
+
+void LineChannel::close()
+{
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool LineChannel::read_line(std::string& line)
+{
+    size_t end;
+    while( (end = m_buffer.find('\n')) == std::string::npos ) {
+        char buf[4096];
+        ssize_t count = m_fd >= 0 ? ::recv(m_fd, buf, sizeof(buf), 0) : -1;
+        if( count <= 0 ) {
+            return false;
+        }
+        m_buffer.append(buf, count);
+    }
+    line = m_buffer.substr(0, end);
+    m_buffer.erase(0, end + 1);
+    return true;
+}
+
+bool LineChannel::write_line(const std::string& line)
+{
+    const std::string data = line + "\n";
+    size_t done = 0;
+    while( done < data.size() ) {
+        // a dead peer is reported as an error instead of SIGPIPE
+        ssize_t count = m_fd >= 0 ? ::send(m_fd, data.data() + done, data.size() - done, MSG_NOSIGNAL) : -1;
+        if( count <= 0 ) {
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+bool LineChannel::set_timeout(int seconds)
+{
+    timeval tv;
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    return setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0;
+}
+
+int LineChannel::connect_to(const std::string& address)
+{
+    if( is_unix_address(address) ) {
+        sockaddr_un addr;
+        if( !unix_address(address, addr) ) {
+            return -1;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if( fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ) {
+            ::close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+    addrinfo* info = tcp_address(address, false);
+    int fd = -1;
+    for(addrinfo* iter=info; iter && fd < 0; iter=iter->ai_next) {
+        fd = socket(iter->ai_family, iter->ai_socktype, iter->ai_protocol);
+        if( fd >= 0 && connect(fd, iter->ai_addr, iter->ai_addrlen) != 0 ) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if( info ) {
+        freeaddrinfo(info);
+    }
+    return fd;
+}
+
+int LineChannel::listen_on(const std::string& address)
+{
+    if( is_unix_address(address) ) {
+        sockaddr_un addr;
+        if( !unix_address(address, addr) ) {
+            return -1;
+        }
+        // socket file of a previous run
+        unlink(addr.sun_path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if( fd >= 0 && (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0) ) {
+            ::close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+    addrinfo* info = tcp_address(address, true);
+    int fd = -1;
+    for(addrinfo* iter=info; iter && fd < 0; iter=iter->ai_next) {
+        fd = socket(iter->ai_family, iter->ai_socktype, iter->ai_protocol);
+        int on = 1;
+        if( fd >= 0 && (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+                        bind(fd, iter->ai_addr, iter->ai_addrlen) != 0 || listen(fd, 16) != 0) ) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if( info ) {
+        freeaddrinfo(info);
+    }
+    return fd;
+}
+
+/*
+ *  ClusterWorker implementation
+ */
+
+ClusterWorker::ClusterWorker(size_t hash_mb):
+    m_tt(hash_mb)
+{}
+
+bool ClusterWorker::run(const std::string& address)
+{
+    int listen_fd = LineChannel::listen_on(address);
+    if( listen_fd < 0 ) {
+        return false;
+    }
+    while( true ) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if( fd < 0 ) {
+            continue;
+        }
+        // the worker lives until the process ends, so the threads are never joined
+        std::thread([this, fd]() {
+            LineChannel channel(fd);
+            Searcher searcher(m_tt);
+            std::string request;
+            while( channel.read_line(request) && channel.write_line(handle(request, searcher)) ) {
+            }
+        }).detach();
+    }
+}
+
+std::string ClusterWorker::handle(const std::string& request, Searcher& searcher)
+{
+    std::istringstream in(request);
+    std::string command;
+    int depth = 0;
+    in >> command >> depth >> std::ws;
+    std::string fen;
+    std::getline(in, fen);
+
+    Position pos;
+    if( !in.eof() || depth < 0 || !pos.set_fen(fen) ) {
+        return "error bad request";
+    }
+    std::ostringstream out;
+    if( command == "perft" ) {
+        out << "nodes " << pos.perft(depth);
+    } else if( command == "search" ) {
+        SearchLimits limits;
+        limits.depth = depth;
+        SearchResult result = searcher.search(pos, limits);
+        out << "result " << result.score << " " << result.depth << " " << result.nodes;
+        for(auto iter=result.pv.begin(); iter!=result.pv.end(); iter++) {
+            out << " " << *iter;
+        }
+    } else {
+        return "error unknown command";
+    }
+    return out.str();
+}
+
+/*
+ *  ClusterCoordinator implementation
+ */
+
+const size_t ClusterCoordinator::TASKS_PER_CONNECTION;
+
+ClusterCoordinator::ClusterCoordinator(const std::vector<std::string>& workers, int timeout):
+    m_workers(workers), m_timeout(timeout), m_elapsed(0)
+{}
+
+uint64_t ClusterCoordinator::nodes() const
+{
+    uint64_t res = 0;
+    for(auto iter=m_stats.begin(); iter!=m_stats.end(); iter++) {
+        res += iter->nodes;
+    }
+    return res;
+}
+
+bool ClusterCoordinator::perft(const Position& pos, int depth, PerftResult& result)
+{
+    result.nodes = 0;
+    result.divide.clear();
+    m_stats.clear();
+    m_elapsed = 0;
+    if( depth <= 0 || !pos.has_king(pos.get_side()) ) {
+        result.nodes = pos.perft(std::max(depth, 0));
+        return true;
+    }
+
+    // positions are expanded level by level until there are enough tasks to balance the load
+    struct Task
+    {
+        Position pos;
+        size_t root;
+    };
+    std::vector<Task> tasks;
+    PackedMove moves[Position::MAX_MOVES];
+    const int count = pos.generate_moves(moves);
+    for(int i=0; i<count; i++) {
+        Task task = { pos, static_cast<size_t>(i) };
+        task.pos.make_move(moves[i]);
+        tasks.push_back(task);
+        result.divide.push_back(std::make_pair(moves[i], uint64_t(0)));
+    }
+    int task_depth = depth - 1;
+    const size_t wanted = TASKS_PER_CONNECTION * m_workers.size();
+    while( task_depth > 1 && tasks.size() < wanted ) {
+        std::vector<Task> next;
+        for(auto iter=tasks.begin(); iter!=tasks.end(); iter++) {
+            if( !iter->pos.has_king(iter->pos.get_side()) ) {
+                continue;
+            }
+            const int children = iter->pos.generate_moves(moves);
+            for(int i=0; i<children; i++) {
+                Task task = { iter->pos, iter->root };
+                task.pos.make_move(moves[i]);
+                next.push_back(task);
+            }
+        }
+        tasks.swap(next);
+        task_depth--;
+    }
+
+    std::vector<std::string> requests;
+    for(auto iter=tasks.begin(); iter!=tasks.end(); iter++) {
+        requests.push_back("perft " + std::to_string(task_depth) + " " + iter->pos.get_fen());
+    }
+    std::vector<std::string> replies;
+    if( !run(requests, replies) ) {
+        return false;
+    }
+    for(size_t i=0; i<tasks.size(); i++) {
+        std::istringstream in(replies[i]);
+        std::string tag;
+        uint64_t nodes = 0;
+        if( !(in >> tag >> nodes) || tag != "nodes" ) {
+            return false;
+        }
+        result.divide[tasks[i].root].second += nodes;
+        result.nodes += nodes;
+    }
+    return true;
+}
+
+bool ClusterCoordinator::analyze(const Position& pos, int depth, SearchResult& result)
+{
+    result = SearchResult();
+    m_stats.clear();
+    m_elapsed = 0;
+    if( !pos.has_king(pos.get_side()) ) {
+        return false;
+    }
+    depth = std::max(depth, 2);
+
+    PackedMove moves[Position::MAX_MOVES];
+    const int count = pos.generate_moves(moves);
+    std::vector<std::string> requests;
+    std::vector<int> searched;             //moves sent to workers
+    for(int i=0; i<count; i++) {
+        Position next(pos);
+        next.make_move(moves[i]);
+        if( !next.has_king(next.get_side()) ) {
+            // taking the king ends the game, nothing to search
+            PvLine line = { MATE_SCORE - 1, std::vector<PackedMove>(1, moves[i]) };
+            result.lines.push_back(line);
+            continue;
+        }
+        requests.push_back("search " + std::to_string(depth - 1) + " " + next.get_fen());
+        searched.push_back(i);
+    }
+    std::vector<std::string> replies;
+    if( !run(requests, replies) ) {
+        return false;
+    }
+    for(size_t i=0; i<searched.size(); i++) {
+        std::istringstream in(replies[i]);
+        std::string tag;
+        int score = 0, child_depth = 0;
+        uint64_t nodes = 0;
+        if( !(in >> tag >> score >> child_depth >> nodes) || tag != "result" ) {
+            return false;
+        }
+        PvLine line;
+        line.score = score_from_child(score);
+        line.pv.push_back(moves[searched[i]]);
+        unsigned move;
+        while( in >> move ) {
+            line.pv.push_back(static_cast<PackedMove>(move));
+        }
+        result.lines.push_back(line);
+        result.nodes += nodes;
+    }
+    if( result.lines.empty() ) {
+        return false;
+    }
+    std::stable_sort(result.lines.begin(), result.lines.end(),
+                     [](const PvLine& l1, const PvLine& l2) { return l1.score > l2.score; });
+    result.valid = true;
+    result.depth = depth;
+    result.score = result.lines[0].score;
+    result.pv = result.lines[0].pv;
+    result.best_move = result.pv[0];
+    return true;
+}
+
+bool ClusterCoordinator::run(const std::vector<std::string>& requests, std::vector<std::string>& replies)
+{
+    auto start = std::chrono::steady_clock::now();
+    replies.assign(requests.size(), std::string());
+    m_stats.clear();
+    for(auto iter=m_workers.begin(); iter!=m_workers.end(); iter++) {
+        ClusterWorkerStats stats = { *iter, 0, 0, false };
+        m_stats.push_back(stats);
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<size_t> queue;
+    for(size_t i=0; i<requests.size(); i++) {
+        queue.push_back(i);
+    }
+    size_t done = 0;
+
+    std::vector<std::thread> threads;
+    for(size_t w=0; w<m_workers.size(); w++) {
+        threads.push_back(std::thread([&, w]() {
+            LineChannel channel(LineChannel::connect_to(m_workers[w]));
+            if( channel.is_open() && m_timeout > 0 ) {
+                channel.set_timeout(m_timeout);
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            bool ok = channel.is_open();
+            while( ok ) {
+                // a failing worker may still give a task back, so idle ones wait for the others to finish
+                cv.wait(lock, [&]() { return !queue.empty() || done == requests.size(); });
+                if( queue.empty() ) {
+                    break;
+                }
+                const size_t task = queue.front();
+                queue.pop_front();
+                lock.unlock();
+
+                std::string reply;
+                ok = channel.write_line(requests[task]) && channel.read_line(reply);
+                uint64_t nodes = 0;
+                if( ok ) {
+                    std::istringstream in(reply);
+                    std::string tag;
+                    in >> tag;
+                    if( tag == "result" ) {
+                        int score, depth;
+                        in >> score >> depth;
+                    }
+                    in >> nodes;
+                }
+
+                lock.lock();
+                if( ok ) {
+                    replies[task] = reply;
+                    m_stats[w].tasks++;
+                    m_stats[w].nodes += nodes;
+                    done++;
+                    if( done == requests.size() ) {
+                        cv.notify_all();
+                    }
+                } else {
+                    queue.push_front(task);
+                    cv.notify_all();
+                }
+            }
+            if( !ok ) {
+                m_stats[w].failed = true;
+            }
+        }));
+    }
+    // every thread ends once all is answered or its worker fails
+    for(auto iter=threads.begin(); iter!=threads.end(); iter++) {
+        iter->join();
+    }
+    m_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(auto iter=replies.begin(); iter!=replies.end(); iter++) {
+        if( iter->empty() || iter->compare(0, 5, "error") == 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
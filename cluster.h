@@ -0,0 +1,118 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "position.h"
+#include "search.h"
+
+/*
+ *  Perft & analysis spread over worker processes.
+ *
+ *  Workers listen on "unix:<path>" or "<host>:<port>" and answer one request line at a time
+ *  per connection:
+ *      "perft <depth> <fen>"   ->  "nodes <count>"
+ *      "search <depth> <fen>"  ->  "result <score> <depth> <nodes> <packed move> ..."
+ *      anything else           ->  "error <text>"
+ *  The coordinator splits the work into many more tasks than connections, every connection
+ *  takes the next task as soon as it is done with the previous one. A task of a broken or
+ *  timed out connection goes back to the queue, the connection is dropped.
+ */
+
+/*
+ *  LineChannel - '\n' separated messages over a socket
+ */
+
+class LineChannel
+{
+public:
+    explicit LineChannel(int fd);
+    ~LineChannel();
+
+    bool is_open() const                                {   return m_fd >= 0;   }
+    bool read_line(std::string& line);
+    bool write_line(const std::string& line);
+    //reads fail after this many seconds without data, 0 - wait forever
+    bool set_timeout(int seconds);
+    void close();
+
+    //@ret connected socket or -1
+    static int connect_to(const std::string& address);
+    //@ret listening socket or -1
+    static int listen_on(const std::string& address);
+private:
+    LineChannel(const LineChannel&);
+    LineChannel& operator=(const LineChannel&);
+
+    int m_fd;
+    std::string m_buffer;
+};
+
+/*
+ *  ClusterWorker - serves every connection in its own thread, searches share one table
+ */
+
+class ClusterWorker
+{
+public:
+    explicit ClusterWorker(size_t hash_mb);
+
+    //blocks accepting connections, @ret false if the address can't be listened on
+    bool run(const std::string& address);
+
+    //answer to a single request line
+    std::string handle(const std::string& request, Searcher& searcher);
+private:
+    TranspositionTable m_tt;
+};
+
+/*
+ *  ClusterCoordinator
+ */
+
+struct PerftResult
+{
+    uint64_t nodes;
+    //leaf count under every root move
+    std::vector<std::pair<PackedMove, uint64_t> > divide;
+};
+
+struct ClusterWorkerStats
+{
+    std::string address;
+    size_t tasks;
+    uint64_t nodes;
+    bool failed;
+};
+
+class ClusterCoordinator
+{
+public:
+    //tasks in flight are bounded by the number of connections, the queue holds this many per connection
+    static const size_t TASKS_PER_CONNECTION = 16;
+
+    //one connection per address, an address may be listed several times
+    //timeout - seconds to wait for an answer before the worker is given up, 0 - forever
+    ClusterCoordinator(const std::vector<std::string>& workers, int timeout);
+
+    bool perft(const Position& pos, int depth, PerftResult& result);
+    //every root move is searched to depth-1 on its own, result.lines holds all of them, best first
+    bool analyze(const Position& pos, int depth, SearchResult& result);
+
+    //of the last run
+    const std::vector<ClusterWorkerStats>& worker_stats() const     {   return m_stats;   }
+    double elapsed_seconds() const                                  {   return m_elapsed;   }
+    uint64_t nodes() const;
+private:
+    //sends requests to the workers, @ret false if all workers failed or a reply is an error
+    bool run(const std::vector<std::string>& requests, std::vector<std::string>& replies);
+
+    std::vector<std::string> m_workers;
+    int m_timeout;
+    std::vector<ClusterWorkerStats> m_stats;
+    double m_elapsed;
+};
+
+#endif // CLUSTER_H
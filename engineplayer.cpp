@@ -0,0 +1,145 @@
+#include "engineplayer.h"
+
+/*
+ *  EnginePlayer implementation
+ */
+
+EnginePlayer::EnginePlayer(size_t hash_mb, const MoveCallback& callback):
+    m_tt(hash_mb), m_searcher(m_tt), m_callback(callback), m_quit(false), m_pondering(false),
+    m_task(Task::NONE), m_started(false), m_running(false), m_interrupted(false), m_ponder_hits(0)
+{
+    m_thread = std::thread(&EnginePlayer::run, this);
+}
+
+EnginePlayer::~EnginePlayer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        interrupt();
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void EnginePlayer::play(const Position& pos, const TimeControl& clock)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_clock = clock;
+        if( m_task == Task::PONDER && m_pos.get_hash() == pos.get_hash() ) {
+            m_ponder_hits++;
+            m_task = Task::THINK;
+            if( m_running ) {
+                // the last completed iteration is the answer if pondering took long enough
+                m_time.start(clock);
+                if( m_time.optimum_spent() ) {
+                    m_searcher.stop();
+                }
+                return;
+            }
+            // ponder search is over (mates or max depth), a new one is answered from the table
+            m_started = false;
+        } else {
+            interrupt();
+            m_task = Task::THINK;
+            m_pos = pos;
+            m_started = false;
+        }
+    }
+    m_wake.notify_one();
+}
+
+void EnginePlayer::set_pondering(bool on)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pondering = on;
+    if( !on && m_task == Task::PONDER ) {
+        interrupt();
+        m_task = Task::NONE;
+    }
+}
+
+void EnginePlayer::stop()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    interrupt();
+    m_task = Task::NONE;
+}
+
+uint64_t EnginePlayer::ponder_hits() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_ponder_hits;
+}
+
+void EnginePlayer::interrupt()
+{
+    if( m_running ) {
+        m_interrupted = true;
+        m_searcher.stop();
+    }
+}
+
+bool EnginePlayer::ponder_position(const Position& pos, const SearchResult& result, Position& ponder)
+{
+    if( result.pv.size() < 2 ) {
+        return false;
+    }
+    ponder = pos;
+    for(int i=0; i<2; i++) {
+        if( !ponder.is_legal(result.pv[i]) ) {
+            return false;
+        }
+        ponder.make_move(result.pv[i]);
+        if( !ponder.has_king(Position::WHITE) || !ponder.has_king(Position::BLACK) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EnginePlayer::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while( !m_quit ) {
+        if( m_task == Task::NONE || m_started ) {
+            m_wake.wait(lock);
+            continue;
+        }
+        const Position pos = m_pos;
+        m_started = true;
+        m_running = true;
+        m_interrupted = false;
+        m_time.reset();
+        if( m_task == Task::THINK ) {
+            m_time.start(m_clock);
+        }
+        m_searcher.resume();
+        m_tt.new_search();
+        lock.unlock();
+
+        SearchLimits limits;
+        limits.time = &m_time;
+        SearchResult result = m_searcher.search(pos, limits);
+
+        lock.lock();
+        m_running = false;
+        // a ponder search that ended by itself waits for play()
+        if( m_interrupted || m_task != Task::THINK ) {
+            continue;
+        }
+        m_task = Task::NONE;
+        Position ponder;
+        if( m_pondering && ponder_position(pos, result, ponder) ) {
+            m_task = Task::PONDER;
+            m_pos = ponder;
+            m_started = false;
+        }
+        lock.unlock();
+        if( m_callback ) {
+            m_callback(pos, result);
+        }
+        lock.lock();
+    }
+}
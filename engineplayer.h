@@ -0,0 +1,77 @@
+#ifndef ENGINEPLAYER_H
+#define ENGINEPLAYER_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "search.h"
+#include "timemanager.h"
+
+/*
+ *  EnginePlayer - the engine side of a game on the clock.
+ *
+ *  play() starts a search budgeted by TimeManager, the chosen move comes through the callback.
+ *  With pondering on, the engine then searches the position after the reply it expects
+ *  (second move of its pv) while the opponent thinks. If the opponent plays that move,
+ *  the search goes on with the clock started: time spent pondering counts toward the
+ *  optimum, so a long enough ponder answers at once. Any other move restarts the search.
+ */
+
+class EnginePlayer
+{
+public:
+    //called from the worker thread, result of the position given to play()
+    typedef std::function<void(const Position& pos, const SearchResult& result)> MoveCallback;
+
+    EnginePlayer(size_t hash_mb, const MoveCallback& callback);
+    ~EnginePlayer();
+
+    //clock - of the side to move
+    void play(const Position& pos, const TimeControl& clock);
+    void set_pondering(bool on);
+    //drops thinking & pondering, no move comes
+    void stop();
+
+    //positions given to play() that were being pondered
+    uint64_t ponder_hits() const;
+private:
+    EnginePlayer(const EnginePlayer&);
+    EnginePlayer& operator=(const EnginePlayer&);
+
+    enum class Task
+    {
+        NONE,
+        THINK,
+        PONDER
+    };
+
+    void run();
+    //stops the running search & drops its result, under m_mutex
+    void interrupt();
+    //position after the move & the expected reply
+    static bool ponder_position(const Position& pos, const SearchResult& result, Position& ponder);
+
+    TranspositionTable m_tt;
+    Searcher m_searcher;
+    TimeManager m_time;
+    MoveCallback m_callback;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit;
+    bool m_pondering;
+    Task m_task;
+    bool m_started;                 //search of m_task has begun, it may be over already
+    bool m_running;
+    bool m_interrupted;
+    Position m_pos;                 //of m_task
+    TimeControl m_clock;
+    uint64_t m_ponder_hits;
+
+    std::thread m_thread;
+};
+
+#endif // ENGINEPLAYER_H
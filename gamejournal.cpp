@@ -0,0 +1,338 @@
+#include "gamejournal.h"
+#include "chessboard.h"
+#include "instrumentation.h"
+#include "mappedfile.h"
+
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::unique_lock;
+using std::lock_guard;
+using std::mutex;
+
+/*
+ *  Auxiliary functions
+ */
+
+struct JournalHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t base_hash;
+    uint64_t base_size;
+};
+
+static const char JOURNAL_MAGIC[4] = {'C','H','J','L'};
+static const uint32_t JOURNAL_VERSION = 1;
+
+inline uint8_t record_check(const GameJournal::Record& r)
+{
+    return static_cast<uint8_t>(0x5A ^ r.action ^ (r.move & 0xFF) ^ (r.move >> 8) ^
+                                (r.seq & 0xFF) ^ ((r.seq >> 8) & 0xFF) ^ ((r.seq >> 16) & 0xFF) ^ (r.seq >> 24));
+}
+
+static bool write_all(int fd, const void* data, size_t size)
+{
+    const char* ptr = static_cast<const char*>(data);
+    while( size > 0 ) {
+        ssize_t n = ::write(fd, ptr, size);
+        if( n <= 0 ) {
+            return false;
+        }
+        ptr += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool replay(ChessBoard& board, const GameJournal::Record& r)
+{
+    vec2 src = unpacked_src(r.move);
+    vec2 dst = unpacked_dst(r.move);
+    switch(r.action) {
+        case GameJournal::MOVE:
+            return static_cast<bool>(board.make_move(src, dst));
+        case GameJournal::UNDO:
+            return static_cast<bool>(board.undo());
+        case GameJournal::REDO: {
+            // redo tail isn't stored in the save file after compaction, the move is replayed then
+            auto move = board.redo();
+            if( move && pack_move(move->get_src_pos(), move->get_dst_pos()) == r.move ) {
+                return true;
+            }
+            if( move ) {
+                board.undo();
+            }
+            return static_cast<bool>(board.make_move(src, dst));
+        }
+        default:
+            return false;
+    }
+}
+
+/*
+ *  GameJournal implementation
+ */
+
+GameJournal::GameJournal():
+    m_fd(-1), m_seq(0), m_base_seq(0)
+{}
+
+GameJournal::~GameJournal()
+{
+    close();
+}
+
+bool GameJournal::create(const string& journal_file, uint64_t base_hash, uint64_t base_size)
+{
+    close();
+    int fd = ::open(journal_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if( fd < 0 ) {
+        return false;
+    }
+    JournalHeader header;
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.base_hash = base_hash;
+    header.base_size = base_size;
+    if( !write_all(fd, &header, sizeof(header)) || fdatasync(fd) != 0 ) {
+        ::close(fd);
+        return false;
+    }
+    m_fd = fd;
+    m_seq = 0;
+    m_base_seq = 0;
+    return true;
+}
+
+bool GameJournal::recover(const string& journal_file, uint64_t base_hash, uint64_t base_size, ChessBoard& board)
+{
+    close();
+    int fd = ::open(journal_file.c_str(), O_RDWR);
+    if( fd < 0 ) {
+        return false;
+    }
+    JournalHeader header;
+    if( ::read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 || header.version != JOURNAL_VERSION ||
+        header.base_hash != base_hash || header.base_size != base_size )
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // records after a torn or corrupted one are dropped
+    uint32_t seq = 0;
+    Record record;
+    while( ::read(fd, &record, sizeof(record)) == sizeof(record) ) {
+        if( record.seq != seq || record.check != record_check(record) || !replay(board, record) ) {
+            break;
+        }
+        seq++;
+    }
+    if( ftruncate(fd, sizeof(header) + seq*sizeof(Record)) != 0 ) {
+        ::close(fd);
+        return false;
+    }
+    ::close(fd);
+
+    m_fd = ::open(journal_file.c_str(), O_WRONLY | O_APPEND);
+    m_seq = seq;
+    m_base_seq = 0;
+    return m_fd >= 0;
+}
+
+void GameJournal::close()
+{
+    if( m_fd >= 0 ) {
+        JournalCommitter::instance().remove(m_fd);
+        fdatasync(m_fd);
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool GameJournal::append(Action action, PackedMove move)
+{
+    PROBE_SCOPE(Probe::JOURNAL_APPEND);
+    if( m_fd < 0 ) {
+        return false;
+    }
+    Record record;
+    record.action = static_cast<uint8_t>(action);
+    record.move = move;
+    record.seq = m_seq;
+    record.check = record_check(record);
+    if( !write_all(m_fd, &record, sizeof(record)) ) {
+        return false;
+    }
+    m_seq++;
+    JournalCommitter::instance().mark_dirty(m_fd);
+    return true;
+}
+
+bool GameJournal::take_snapshot(ChessBoard& board, Snapshot& snapshot)
+{
+    std::ostringstream out;
+    if( !board.save_game(out) ) {
+        return false;
+    }
+    snapshot.game = out.str();
+    snapshot.line = board.get_current_line();
+    return true;
+}
+
+bool GameJournal::compact(const string& save_file, const string& journal_file,
+                          ChessBoard& board, GameJournal& journal)
+{
+    Snapshot snapshot;
+    bool replaced;
+    return take_snapshot(board, snapshot) && compact(save_file, journal_file, snapshot, journal, replaced);
+}
+
+bool GameJournal::compact(const string& save_file, const string& journal_file,
+                          const Snapshot& snapshot, GameJournal& journal, bool& replaced)
+{
+    const string& data = snapshot.game;
+    replaced = false;
+
+    // new save file is made durable before it replaces the old one,
+    // old journal stays valid for the old save file until then
+    const string tmp_file = save_file + ".tmp";
+    int fd = ::open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if( fd < 0 ) {
+        return false;
+    }
+    bool ok = write_all(fd, data.data(), data.size()) && fsync(fd) == 0;
+    ::close(fd);
+    if( !ok || std::rename(tmp_file.c_str(), save_file.c_str()) != 0 ) {
+        std::remove(tmp_file.c_str());
+        return false;
+    }
+    replaced = true;
+    // a journal based on the new file must not outlive a rename lost on power failure
+    if( !sync_parent_dir(save_file) ) {
+        return false;
+    }
+
+    // loading lands at the end of the main line, journal starts with a way back to the current position
+    ChessBoard loaded;
+    std::istringstream in(data);
+    loaded.load_game(in);
+    if( !journal.create(journal_file, loaded.get_hash(), data.size()) ) {
+        return false;
+    }
+    const std::vector<PackedMove> from = loaded.get_current_line();
+    const std::vector<PackedMove>& to = snapshot.line;
+    size_t common = 0;
+    while( common < from.size() && common < to.size() && from[common] == to[common] ) {
+        common++;
+    }
+    for(size_t i=common; i<from.size(); i++) {
+        journal.append(UNDO, from[from.size()-1-(i-common)]);
+    }
+    for(size_t i=common; i<to.size(); i++) {
+        journal.append(MOVE, to[i]);
+    }
+    // a long way back must not trigger the next compaction right away
+    journal.defer_compaction();
+    return true;
+}
+
+/*
+ *  JournalCommitter implementation
+ */
+
+const int JournalCommitter::INTERVAL_MS;
+const size_t JournalCommitter::BATCH_RECORDS;
+
+JournalCommitter& JournalCommitter::instance()
+{
+    static JournalCommitter committer;
+    return committer;
+}
+
+JournalCommitter::JournalCommitter():
+    m_pending(0), m_committing(false), m_stop(false)
+{
+    m_thread = std::thread(&JournalCommitter::run, this);
+}
+
+JournalCommitter::~JournalCommitter()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void JournalCommitter::mark_dirty(int fd)
+{
+    bool wake;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_dirty.insert(fd);
+        wake = ++m_pending >= BATCH_RECORDS;
+    }
+    if( wake ) {
+        m_cv.notify_all();
+    }
+}
+
+void JournalCommitter::remove(int fd)
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_dirty.erase(fd);
+    m_cv.wait(lock, [this]() { return !m_committing; });
+}
+
+void JournalCommitter::flush()
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_cv.wait(lock, [this]() { return !m_committing; });
+    commit(lock);
+}
+
+void JournalCommitter::commit(unique_lock<mutex>& lock)
+{
+    // pending count of removed journals goes too, otherwise the wait in run() never blocks again
+    m_pending = 0;
+    if( m_dirty.empty() ) {
+        return;
+    }
+    std::set<int> dirty;
+    dirty.swap(m_dirty);
+    m_committing = true;
+    lock.unlock();
+
+    {
+        PROBE_SCOPE(Probe::JOURNAL_COMMIT);
+        for(auto iter=dirty.begin(); iter!=dirty.end(); iter++) {
+            fdatasync(*iter);
+        }
+    }
+
+    lock.lock();
+    m_committing = false;
+    m_cv.notify_all();
+}
+
+void JournalCommitter::run()
+{
+    unique_lock<mutex> lock(m_mutex);
+    while( !m_stop ) {
+        m_cv.wait_for(lock, std::chrono::milliseconds(INTERVAL_MS),
+                      [this]() { return m_stop || m_pending >= BATCH_RECORDS; });
+        if( !m_committing ) {
+            commit(lock);
+        }
+    }
+    commit(lock);
+}
@@ -0,0 +1,126 @@
+#ifndef GAMEJOURNAL_H
+#define GAMEJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include <cstdint>
+
+#include "chesspiecemove.h"
+
+class ChessBoard;
+
+/*
+ *  GameJournal - append-only log of board actions next to a saved game
+ *
+ *  File starts with a header naming the save file state it continues
+ *  (position hash & file size), then fixed size records follow.
+ *  Journal whose base doesn't match the save file is stale and ignored -
+ *  this happens if compaction was interrupted after the save file was replaced.
+ */
+
+class GameJournal
+{
+public:
+    enum Action {
+        MOVE = 1,
+        UNDO,
+        REDO
+    };
+
+    struct Record
+    {
+        uint8_t action;
+        uint8_t check;
+        PackedMove move;
+        uint32_t seq;
+    };
+
+    //compaction is requested after this many records since the last one
+    static const uint32_t COMPACT_RECORDS = 256;
+
+    //game to compact, taken by the thread that owns the board
+    struct Snapshot
+    {
+        std::string game;                       //in ChessBoard::save_game format
+        std::vector<PackedMove> line;           //current line, the journal leads back to it
+    };
+
+    GameJournal();
+    ~GameJournal();
+
+    //starts a new empty journal for the state stored in save_file
+    bool create(const std::string& journal_file, uint64_t base_hash, uint64_t base_size);
+    //replays journal over the board loaded from the save file & reopens it for appending
+    //@ret false if journal is missing or stale, board is untouched then
+    bool recover(const std::string& journal_file, uint64_t base_hash, uint64_t base_size, ChessBoard& board);
+    void close();
+
+    bool is_open() const                        {   return m_fd >= 0;   }
+    //hands an open journal over, e.g. one started by a compaction on another thread
+    void swap(GameJournal& other)
+    {
+        std::swap(m_fd, other.m_fd);
+        std::swap(m_seq, other.m_seq);
+        std::swap(m_base_seq, other.m_base_seq);
+    }
+    bool append(Action action, PackedMove move);
+    bool needs_compaction() const               {   return m_seq - m_base_seq >= COMPACT_RECORDS;   }
+    //records for the next compaction are counted from now
+    void defer_compaction()                     {   m_base_seq = m_seq;   }
+
+    static bool take_snapshot(ChessBoard& board, Snapshot& snapshot);
+    //save file is rewritten atomically from the snapshot, journal starts from scratch;
+    //touches no board, may run on another thread than the one appending
+    //replaced - save file was rewritten, the old journal is stale even if false is returned
+    static bool compact(const std::string& save_file, const std::string& journal_file,
+                        const Snapshot& snapshot, GameJournal& journal, bool& replaced);
+    static bool compact(const std::string& save_file, const std::string& journal_file,
+                        ChessBoard& board, GameJournal& journal);
+private:
+    GameJournal(const GameJournal&);
+    GameJournal& operator=(const GameJournal&);
+
+    int m_fd;
+    uint32_t m_seq;
+    uint32_t m_base_seq;                        //m_seq when compaction was last done or deferred
+};
+
+/*
+ *  JournalCommitter - group commit of all journals in the process:
+ *  appends only hit page cache, the committer thread syncs dirty journals in batches
+ */
+
+class JournalCommitter
+{
+public:
+    static const int INTERVAL_MS = 50;
+    static const size_t BATCH_RECORDS = 64;
+
+    static JournalCommitter& instance();
+
+    void mark_dirty(int fd);
+    //forgets fd, waits for commit in progress
+    void remove(int fd);
+    //syncs everything right now
+    void flush();
+private:
+    JournalCommitter();
+    ~JournalCommitter();
+    void run();
+    void commit(std::unique_lock<std::mutex>& lock);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::set<int> m_dirty;
+    size_t m_pending;
+    bool m_committing;
+    bool m_stop;
+    std::thread m_thread;
+};
+
+#endif // GAMEJOURNAL_H
@@ -0,0 +1,338 @@
+#include "gamemanager.h"
+#include "chessboard.h"
+
+#include <algorithm>
+
+using std::vector;
+using std::lock_guard;
+using std::mutex;
+
+/*
+ *  Auxiliary functions
+ */
+
+static const int CASTLING_ROWS[PackedPosition::CASTLING_SQUARES] = { 0, 0, 0, 7, 7, 7 };
+static const int CASTLING_COLS[PackedPosition::CASTLING_SQUARES] = { 0, 4, 7, 0, 4, 7 };
+
+//history record: bits 0-11 move, 12-15 captured piece, 16-21 castling flags before the move,
+//22 promotion, 23 castling, 24-31 halfmove clock before the move
+inline MoveArena::Record make_record(PackedMove move, ChessPiece captured, const PackedPosition& pos,
+                                     bool promotion, bool castling)
+{
+    return move | (to_int(captured) << 12) | (pos.castling << 16) |
+           (promotion ? 1 << 22 : 0) | (castling ? 1 << 23 : 0) |
+           (static_cast<uint32_t>(pos.halfmove_clock) << 24);
+}
+
+static const PackedPosition& start_position()
+{
+    struct Init {
+        PackedPosition pos;
+        Init()
+        {
+            ChessBoard board;
+            board.reset_board();
+            ChessPiece cells[8][8];
+            bool flags[8][8];
+            for(int r=0; r<8; r++) {
+                for(int c=0; c<8; c++) {
+                    cells[r][c] = board.get_board_piece(r, c);
+                    flags[r][c] = board.is_1st_move(r, c);
+                }
+            }
+            GameManager::to_packed(cells, flags, pos);
+            pos.side = ChessBoard::WHITE;
+            pos.halfmove_clock = 0;
+        }
+    };
+    static const Init init;
+    return init.pos;
+}
+
+/*
+ *  MoveArena implementation
+ */
+
+uint32_t MoveArena::allocate(uint32_t prev)
+{
+    uint32_t ind;
+    if( !m_free.empty() ) {
+        ind = m_free.back();
+        m_free.pop_back();
+    } else {
+        ind = static_cast<uint32_t>(m_chunks.size());
+        m_chunks.push_back(Chunk());
+    }
+    m_chunks[ind].prev = prev;
+    m_chunks[ind].next = NIL;
+    if( prev != NIL ) {
+        m_chunks[prev].next = ind;
+    }
+    return ind;
+}
+
+void MoveArena::release(uint32_t chunk)
+{
+    uint32_t prev = m_chunks[chunk].prev;
+    if( prev != NIL ) {
+        m_chunks[prev].next = NIL;
+    }
+    m_free.push_back(chunk);
+}
+
+/*
+ *  GameManager implementation
+ */
+
+GameManager::GameManager():
+    m_next_shard(0)
+{}
+
+void GameManager::to_packed(const ChessPiece (&board)[8][8], const bool (&first_move_flags)[8][8], PackedPosition& pos)
+{
+    for(int r=0; r<8; r++) {
+        for(int c=0; c<8; c++) {
+            pos.set(r, c, board[r][c]);
+        }
+    }
+    pos.castling = 0;
+    for(int i=0; i<PackedPosition::CASTLING_SQUARES; i++) {
+        if( first_move_flags[CASTLING_ROWS[i]][CASTLING_COLS[i]] ) {
+            pos.castling |= 1 << i;
+        }
+    }
+}
+
+void GameManager::from_packed(const PackedPosition& pos, ChessPiece (&board)[8][8], bool (&first_move_flags)[8][8])
+{
+    for(int r=0; r<8; r++) {
+        for(int c=0; c<8; c++) {
+            board[r][c] = pos.get(r, c);
+            first_move_flags[r][c] = false;
+        }
+    }
+    // only castling squares flags affect legality of moves
+    for(int i=0; i<PackedPosition::CASTLING_SQUARES; i++) {
+        first_move_flags[CASTLING_ROWS[i]][CASTLING_COLS[i]] = (pos.castling >> i) & 1;
+    }
+}
+
+GameManager::Game* GameManager::find_game(Shard& shard, GameId id)
+{
+    uint32_t slot = slot_of(id);
+    if( slot >= shard.games.size() || !shard.games[slot].alive || shard.games[slot].generation != (id >> 32) ) {
+        return NULL;
+    }
+    return &shard.games[slot];
+}
+
+const GameManager::Game* GameManager::find_game(const Shard& shard, GameId id)
+{
+    return find_game(const_cast<Shard&>(shard), id);
+}
+
+GameManager::GameId GameManager::create_game()
+{
+    uint32_t shard_ind = m_next_shard++ % SHARDS;
+    Shard& shard = m_shards[shard_ind];
+    lock_guard<mutex> lock(shard.mutex);
+
+    uint32_t slot;
+    if( !shard.free_slots.empty() ) {
+        slot = shard.free_slots.back();
+        shard.free_slots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(shard.games.size());
+        shard.games.push_back(Game());
+        shard.games[slot].generation = 0;
+    }
+    Game& game = shard.games[slot];
+    game.position = start_position();
+    game.alive = 1;
+    game.length = 0;
+    game.head = game.tail = MoveArena::NIL;
+
+    return (static_cast<GameId>(game.generation) << 32) | (slot*SHARDS + shard_ind);
+}
+
+void GameManager::destroy_game(GameId id)
+{
+    Shard& shard = shard_of(id);
+    lock_guard<mutex> lock(shard.mutex);
+    Game* game = find_game(shard, id);
+    if( !game ) {
+        return;
+    }
+    for(uint32_t chunk = game->tail; chunk != MoveArena::NIL; ) {
+        uint32_t prev = shard.arena[chunk].prev;
+        shard.arena.release(chunk);
+        chunk = prev;
+    }
+    game->alive = 0;
+    game->generation++;
+    shard.free_slots.push_back(slot_of(id));
+}
+
+bool GameManager::make_move(GameId id, const vec2& src, const vec2& dst)
+{
+    Shard& shard = shard_of(id);
+    lock_guard<mutex> lock(shard.mutex);
+    Game* game = find_game(shard, id);
+    if( !game ) {
+        return false;
+    }
+    PackedPosition& pos = game->position;
+
+    // move is validated by ChessBoard to keep rules in one place
+    thread_local ChessBoard scratch;
+    ChessPiece cells[8][8];
+    bool flags[8][8];
+    from_packed(pos, cells, flags);
+    scratch.set_position(cells, flags, pos.side, pos.halfmove_clock);
+
+    auto move = scratch.make_move(src, dst);
+    if( !move ) {
+        return false;
+    }
+
+    ChessPiece src_piece = pos.get(src[0], src[1]);
+    bool promotion = is_pawn(src_piece) && (dst[0] == 0 || dst[0] == 7);
+    bool castling = move->changed_cells_count() == 4;
+    MoveArena::Record record = make_record(pack_move(src, dst), pos.get(dst[0], dst[1]), pos, promotion, castling);
+
+    const int count = move->changed_cells_count();
+    auto changed = move->get_changed_cells();
+    for(int i=0; i<count; i++) {
+        pos.set(changed[i].first[0], changed[i].first[1], changed[i].second);
+    }
+    pos.castling = 0;
+    for(int i=0; i<PackedPosition::CASTLING_SQUARES; i++) {
+        if( scratch.is_1st_move(CASTLING_ROWS[i], CASTLING_COLS[i]) ) {
+            pos.castling |= 1 << i;
+        }
+    }
+    pos.side = static_cast<uint8_t>(1 - pos.side);
+    pos.halfmove_clock = move->is_irreversible() ? 0 : static_cast<uint8_t>(std::min(255, pos.halfmove_clock+1));
+
+    int offset = game->length % MoveArena::CHUNK_RECORDS;
+    if( offset == 0 ) {
+        game->tail = shard.arena.allocate(game->tail);
+        if( game->head == MoveArena::NIL ) {
+            game->head = game->tail;
+        }
+    }
+    shard.arena[game->tail].records[offset] = record;
+    game->length++;
+    return true;
+}
+
+bool GameManager::undo(GameId id)
+{
+    Shard& shard = shard_of(id);
+    lock_guard<mutex> lock(shard.mutex);
+    Game* game = find_game(shard, id);
+    if( !game || game->length == 0 ) {
+        return false;
+    }
+
+    game->length--;
+    int offset = game->length % MoveArena::CHUNK_RECORDS;
+    MoveArena::Record record = shard.arena[game->tail].records[offset];
+    if( offset == 0 ) {
+        uint32_t prev = shard.arena[game->tail].prev;
+        shard.arena.release(game->tail);
+        game->tail = prev;
+        if( prev == MoveArena::NIL ) {
+            game->head = MoveArena::NIL;
+        }
+    }
+
+    PackedPosition& pos = game->position;
+    PackedMove move = record & 0xFFF;
+    vec2 src = unpacked_src(move);
+    vec2 dst = unpacked_dst(move);
+    ChessPiece captured = static_cast<ChessPiece>((record >> 12) & 0xF);
+    bool promotion = (record >> 22) & 1;
+    bool castling = (record >> 23) & 1;
+
+    pos.side = static_cast<uint8_t>(1 - pos.side);
+    if( castling ) {
+        // king went two squares towards the castle, castle jumped over it
+        int inc = (dst[1] > src[1]) ? 1 : -1;
+        ChessPiece king = pos.get(src[0], src[1] + 2*inc);
+        ChessPiece castle = pos.get(src[0], src[1] + inc);
+        pos.set(src[0], src[1] + 2*inc, ChessPiece::NONE);
+        pos.set(src[0], src[1] + inc, ChessPiece::NONE);
+        pos.set(src[0], src[1], king);
+        pos.set(dst[0], dst[1], castle);
+    } else {
+        ChessPiece piece = pos.get(dst[0], dst[1]);
+        if( promotion ) {
+            piece = (pos.side == ChessBoard::WHITE) ? ChessPiece::WT_PAWN : ChessPiece::BK_PAWN;
+        }
+        pos.set(src[0], src[1], piece);
+        pos.set(dst[0], dst[1], captured);
+    }
+    pos.castling = static_cast<uint8_t>((record >> 16) & 0x3F);
+    pos.halfmove_clock = static_cast<uint8_t>(record >> 24);
+    return true;
+}
+
+ChessPiece GameManager::get_piece(GameId id, int r, int c) const
+{
+    const Shard& shard = shard_of(id);
+    lock_guard<mutex> lock(shard.mutex);
+    const Game* game = find_game(shard, id);
+    return game ? game->position.get(r, c) : ChessPiece::NONE;
+}
+
+int GameManager::get_current_side(GameId id) const
+{
+    const Shard& shard = shard_of(id);
+    lock_guard<mutex> lock(shard.mutex);
+    const Game* game = find_game(shard, id);
+    return game ? game->position.side : ChessBoard::WHITE;
+}
+
+vector<PackedMove> GameManager::get_history(GameId id) const
+{
+    vector<PackedMove> res;
+    const Shard& shard = shard_of(id);
+    lock_guard<mutex> lock(shard.mutex);
+    const Game* game = find_game(shard, id);
+    if( !game ) {
+        return res;
+    }
+    res.reserve(game->length);
+    uint32_t chunk = game->head;
+    for(uint32_t i=0; i<game->length; i++) {
+        int offset = i % MoveArena::CHUNK_RECORDS;
+        if( offset == 0 && i > 0 ) {
+            chunk = shard.arena[chunk].next;
+        }
+        res.push_back(shard.arena[chunk].records[offset] & 0xFFF);
+    }
+    return res;
+}
+
+size_t GameManager::games_count() const
+{
+    size_t count = 0;
+    for(int i=0; i<SHARDS; i++) {
+        lock_guard<mutex> lock(m_shards[i].mutex);
+        count += m_shards[i].games.size() - m_shards[i].free_slots.size();
+    }
+    return count;
+}
+
+size_t GameManager::memory_usage() const
+{
+    size_t bytes = sizeof(*this);
+    for(int i=0; i<SHARDS; i++) {
+        lock_guard<mutex> lock(m_shards[i].mutex);
+        bytes += m_shards[i].games.capacity()*sizeof(Game) +
+                 m_shards[i].free_slots.capacity()*sizeof(uint32_t) +
+                 m_shards[i].arena.memory_usage();
+    }
+    return bytes;
+}
@@ -0,0 +1,132 @@
+#ifndef GAMEMANAGER_H
+#define GAMEMANAGER_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "chesspiecemove.h"
+
+/*
+ *  PackedPosition - 4 bits per square plus castling flags
+ */
+
+struct PackedPosition
+{
+    //castling flags bits, same order as Zobrist::castling_square: a1, e1, h1, a8, e8, h8
+    static const int CASTLING_SQUARES = 6;
+
+    uint8_t cells[32];
+    uint8_t castling;
+    uint8_t side;
+    uint8_t halfmove_clock;
+
+    ChessPiece get(int r, int c) const
+    {
+        int sq = r*8 + c;
+        return static_cast<ChessPiece>((cells[sq >> 1] >> ((sq & 1) * 4)) & 0xF);
+    }
+    void set(int r, int c, ChessPiece cp)
+    {
+        int sq = r*8 + c;
+        int shift = (sq & 1) * 4;
+        cells[sq >> 1] = static_cast<uint8_t>((cells[sq >> 1] & ~(0xF << shift)) | (to_int(cp) << shift));
+    }
+};
+
+/*
+ *  MoveArena - pool of fixed size chunks with game histories,
+ *  chunks of finished games are reused by new ones
+ */
+
+class MoveArena
+{
+public:
+    //move, captured piece, previous castling flags & halfmove clock
+    typedef uint32_t Record;
+    static const uint32_t NIL = UINT32_MAX;
+    static const int CHUNK_RECORDS = 14;
+
+    struct Chunk
+    {
+        uint32_t prev;
+        uint32_t next;
+        Record records[CHUNK_RECORDS];
+    };
+
+    uint32_t allocate(uint32_t prev);
+    void release(uint32_t chunk);
+
+    Chunk& operator[](uint32_t ind)                     {   return m_chunks[ind];   }
+    const Chunk& operator[](uint32_t ind) const         {   return m_chunks[ind];   }
+
+    size_t memory_usage() const                         {   return m_chunks.capacity()*sizeof(Chunk) + m_free.capacity()*sizeof(uint32_t);   }
+private:
+    std::vector<Chunk> m_chunks;
+    std::vector<uint32_t> m_free;
+};
+
+/*
+ *  GameManager - lots of independent games in one process,
+ *  games are split into shards with own lock & arena so threads rarely contend
+ */
+
+class GameManager
+{
+public:
+    //slot & shard in the low half, generation of the slot in the high one:
+    //handles of destroyed games stay invalid when their slot is reused
+    typedef uint64_t GameId;
+    static const GameId INVALID_GAME = UINT64_MAX;
+    static const int SHARDS = 64;
+
+    GameManager();
+
+    GameId create_game();
+    void destroy_game(GameId id);
+
+    bool make_move(GameId id, const vec2& src, const vec2& dst);
+    bool undo(GameId id);
+
+    ChessPiece get_piece(GameId id, int r, int c) const;
+    int get_current_side(GameId id) const;
+    //moves from the start position
+    std::vector<PackedMove> get_history(GameId id) const;
+
+    size_t games_count() const;
+    size_t memory_usage() const;
+
+    static void to_packed(const ChessPiece (&board)[8][8], const bool (&first_move_flags)[8][8], PackedPosition& pos);
+    static void from_packed(const PackedPosition& pos, ChessPiece (&board)[8][8], bool (&first_move_flags)[8][8]);
+private:
+    struct Game
+    {
+        PackedPosition position;
+        uint8_t alive;
+        uint32_t generation;
+        uint32_t length;
+        uint32_t head;
+        uint32_t tail;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<Game> games;
+        std::vector<uint32_t> free_slots;
+        MoveArena arena;
+    };
+
+    Shard& shard_of(GameId id)                          {   return m_shards[id % SHARDS];   }
+    const Shard& shard_of(GameId id) const              {   return m_shards[id % SHARDS];   }
+    static uint32_t slot_of(GameId id)                  {   return static_cast<uint32_t>(id) / SHARDS;   }
+    static Game* find_game(Shard& shard, GameId id);
+    static const Game* find_game(const Shard& shard, GameId id);
+
+    Shard m_shards[SHARDS];
+    std::atomic<uint32_t> m_next_shard;
+};
+
+#endif // GAMEMANAGER_H
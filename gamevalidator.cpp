@@ -0,0 +1,394 @@
+#include "gamevalidator.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+
+/*
+ *  Auxiliary functions
+ */
+
+namespace
+{
+
+struct FileTask
+{
+    std::string path;
+    std::string relative;
+};
+
+struct Counters
+{
+    std::atomic<uint64_t> files;
+    std::atomic<uint64_t> games;
+    std::atomic<uint64_t> moves;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> invalid_games;
+    std::atomic<uint64_t> converted_games;
+};
+
+struct GameText
+{
+    size_t begin;
+    size_t end;
+    size_t line;
+};
+
+}
+
+//longest piece of a malformed move quoted in the message
+static const size_t QUOTE_CHARS = 16;
+
+//regular files under path in name order, relative names start below the root
+static void collect_files(const std::string& path, const std::string& relative, std::vector<FileTask>& files)
+{
+    struct stat st;
+    if( stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode) ) {
+        DIR* dir = opendir(path.c_str());
+        if( !dir ) {
+            return;
+        }
+        std::vector<std::string> names;
+        while( dirent* entry = readdir(dir) ) {
+            if( strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..") ) {
+                names.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        for(auto iter=names.begin(); iter!=names.end(); iter++) {
+            collect_files(path + "/" + *iter, relative.empty() ? *iter : relative + "/" + *iter, files);
+        }
+        return;
+    }
+    // missing & unreadable files are reported when they are opened
+    FileTask task = { path, relative };
+    files.push_back(task);
+}
+
+static std::string base_name(const std::string& path)
+{
+    const size_t pos = path.find_last_of('/');
+    return (pos == std::string::npos) ? path : path.substr(pos + 1);
+}
+
+//creates missing parent directories of a file
+static void make_parent_dirs(const std::string& file)
+{
+    for(size_t pos=file.find('/', 1); pos!=std::string::npos; pos=file.find('/', pos + 1)) {
+        mkdir(file.substr(0, pos).c_str(), 0755);
+    }
+}
+
+inline void skip_spaces(const char*& p, const char* end)
+{
+    while( p < end && isspace(static_cast<unsigned char>(*p)) ) {
+        p++;
+    }
+}
+
+inline bool expect(const char*& p, const char* end, char ch)
+{
+    skip_spaces(p, end);
+    if( p == end || *p != ch ) {
+        return false;
+    }
+    p++;
+    return true;
+}
+
+//"e2", spaces are allowed like in read_vec2
+static bool parse_square(const char*& p, const char* end, vec2& v)
+{
+    skip_spaces(p, end);
+    if( p == end || *p < 'a' || *p > 'h' ) {
+        return false;
+    }
+    const char cln = *p++;
+    skip_spaces(p, end);
+    if( p == end || *p < '1' || *p > '8' ) {
+        return false;
+    }
+    v = make_vec2(*p++ - '1', cln - 'a');
+    return true;
+}
+
+static bool parse_move(const char*& p, const char* end, vec2& src, vec2& dst)
+{
+    return expect(p, end, '[') && parse_square(p, end, src) && expect(p, end, ',') &&
+           parse_square(p, end, dst) && expect(p, end, ']');
+}
+
+static size_t count_lines(const char* begin, const char* end)
+{
+    return std::count(begin, end, '\n');
+}
+
+/*
+ *  GameValidator implementation
+ */
+
+const uint16_t GameValidator::VARIATION_START;
+const uint16_t GameValidator::VARIATION_END;
+const uint16_t GameValidator::GAME_END;
+const char GameValidator::COMPACT_MAGIC[] = "CHSGAME1";
+const char GameValidator::COMPACT_SUFFIX[] = ".cgame";
+
+GameValidator::GameValidator(int threads):
+    m_threads(std::max(threads, 1))
+{}
+
+bool GameValidator::parse_text(const char* begin, const char* end, std::vector<uint16_t>& tokens,
+                               std::vector<size_t>& offsets, size_t& error_offset, std::string& message)
+{
+    tokens.clear();
+    offsets.clear();
+    const char* p = begin;
+    while( true ) {
+        skip_spaces(p, end);
+        if( p == end ) {
+            return true;
+        }
+        const char* start = p;
+        vec2 src, dst;
+        if( *p == '(' || *p == ')' ) {
+            tokens.push_back(*p == '(' ? VARIATION_START : VARIATION_END);
+            p++;
+        } else if( parse_move(p, end, src, dst) ) {
+            tokens.push_back(pack_move(src, dst));
+        } else {
+            const char* quote_end = start;
+            while( quote_end < end && quote_end - start < static_cast<ptrdiff_t>(QUOTE_CHARS) &&
+                   !isspace(static_cast<unsigned char>(*quote_end)) ) {
+                quote_end++;
+            }
+            error_offset = start - begin;
+            message = "malformed move \"" + std::string(start, quote_end) + "\"";
+            return false;
+        }
+        offsets.push_back(start - begin);
+    }
+}
+
+bool GameValidator::replay(const std::vector<uint16_t>& tokens, ChessBoard& board, size_t& bad_token, int& ply,
+                           std::string& message)
+{
+    board.reset_board();
+    // moves of the current line & opened variations: ply before the replaced move, the move itself
+    std::vector<PackedMove> line;
+    std::vector<std::pair<int, PackedMove> > variations;
+    for(size_t i=0; i<tokens.size(); i++) {
+        const uint16_t token = tokens[i];
+        bad_token = i;
+        ply = board.get_ply() + 1;
+        if( token == VARIATION_START ) {
+            if( line.empty() ) {
+                message = "variation before the first move";
+                return false;
+            }
+            variations.push_back(std::make_pair(board.get_ply() - 1, line.back()));
+            board.undo();
+            line.pop_back();
+        } else if( token == VARIATION_END ) {
+            if( variations.empty() ) {
+                message = "unmatched ')'";
+                return false;
+            }
+            while( board.get_ply() > variations.back().first ) {
+                board.undo();
+                line.pop_back();
+            }
+            const PackedMove move = variations.back().second;
+            variations.pop_back();
+            board.make_move(unpacked_src(move), unpacked_dst(move));
+            line.push_back(move);
+        } else if( token >= 64*64 ) {
+            message = "bad token";
+            return false;
+        } else {
+            if( !board.make_move(unpacked_src(token), unpacked_dst(token)) ) {
+                message = "illegal move " + ChessBoard::moves_to_string(std::vector<PackedMove>(1, token));
+                return false;
+            }
+            line.push_back(token);
+        }
+    }
+    if( !variations.empty() ) {
+        bad_token = tokens.size();
+        ply = board.get_ply();
+        message = "unclosed variation";
+        return false;
+    }
+    return true;
+}
+
+GameValidatorStats GameValidator::validate(const std::vector<std::string>& paths, bool one_per_line,
+                                           const std::string& convert_dir, const IssueCallback& callback)
+{
+    std::vector<FileTask> files;
+    for(auto iter=paths.begin(); iter!=paths.end(); iter++) {
+        struct stat st;
+        const bool is_dir = stat(iter->c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        collect_files(*iter, is_dir ? std::string() : base_name(*iter), files);
+    }
+
+    Counters counters;
+    counters.files = counters.games = counters.moves = counters.bytes = 0;
+    counters.invalid_games = counters.converted_games = 0;
+    std::mutex report_mutex;
+    auto report = [&](const std::string& file, size_t line, int ply, const std::string& message) {
+        GameIssue issue = { file, line, ply, message };
+        std::lock_guard<std::mutex> lock(report_mutex);
+        callback(issue);
+    };
+
+    ThreadPool pool(m_threads);
+    std::vector<std::unique_ptr<ChessBoard> > boards;
+    for(int i=0; i<pool.threads_count(); i++) {
+        boards.push_back(std::unique_ptr<ChessBoard>(new ChessBoard()));
+    }
+
+    for(auto iter=files.begin(); iter!=files.end(); iter++) {
+        const FileTask& file = *iter;
+        pool.submit([&, one_per_line]() {
+            ChessBoard& board = *boards[ThreadPool::worker_index()];
+            struct stat st;
+            MappedFile mapped;
+            // empty files can't be mapped, they are games without moves
+            if( stat(file.path.c_str(), &st) != 0 || (st.st_size > 0 && !mapped.open(file.path)) ) {
+                report(file.path, 0, 0, "can't read file");
+                return;
+            }
+            const char* data = mapped.is_open() ? mapped.data() : "";
+            const size_t size = mapped.is_open() ? mapped.size() : 0;
+            counters.files++;
+            counters.bytes += size;
+
+            const size_t magic_size = strlen(COMPACT_MAGIC);
+            const bool compact = size >= magic_size && !memcmp(data, COMPACT_MAGIC, magic_size);
+            std::vector<uint16_t> tokens;
+            std::vector<size_t> offsets;
+            std::vector<uint16_t> output;
+            size_t bad_token;
+            int ply;
+            std::string message;
+
+            // games of a compact file are taken out on the fly
+            std::vector<GameText> texts;
+            if( !compact ) {
+                size_t begin = 0;
+                size_t line = 1;
+                while( begin < size ) {
+                    const char* newline = one_per_line ? static_cast<const char*>(memchr(data + begin, '\n', size - begin))
+                                                       : NULL;
+                    const size_t end = newline ? newline - data : size;
+                    const char* p = data + begin;
+                    skip_spaces(p, data + end);
+                    if( p < data + end || !one_per_line ) {
+                        GameText text = { begin, end, line };
+                        texts.push_back(text);
+                    }
+                    begin = end + 1;
+                    line++;
+                }
+                if( texts.empty() && !one_per_line ) {
+                    GameText text = { 0, 0, 1 };
+                    texts.push_back(text);
+                }
+            }
+
+            size_t game = 0;
+            size_t pos = magic_size;
+            while( compact ? pos < size : game < texts.size() ) {
+                size_t line;
+                size_t error_offset = 0;
+                bool parsed = true;
+                if( compact ) {
+                    line = game + 1;
+                    tokens.clear();
+                    bool ended = false;
+                    for(; pos + 1 < size && !ended; pos += 2) {
+                        const uint16_t token = static_cast<unsigned char>(data[pos]) |
+                                               static_cast<unsigned char>(data[pos + 1]) << 8;
+                        ended = (token == GAME_END);
+                        if( !ended ) {
+                            tokens.push_back(token);
+                        }
+                    }
+                    if( !ended ) {
+                        parsed = false;
+                        message = "truncated game";
+                        pos = size;
+                    }
+                } else {
+                    const GameText& text = texts[game];
+                    line = text.line;
+                    parsed = parse_text(data + text.begin, data + text.end, tokens, offsets, error_offset, message);
+                }
+                game++;
+                counters.games++;
+
+                // moves before a malformed one may already be illegal, the first error wins
+                std::string replay_message;
+                const bool played = replay(tokens, board, bad_token, ply, replay_message);
+                counters.moves += std::count_if(tokens.begin(), tokens.begin() + (played ? tokens.size() : bad_token),
+                                                [](uint16_t token) { return token < VARIATION_START; });
+                if( played && parsed ) {
+                    if( !convert_dir.empty() ) {
+                        output.insert(output.end(), tokens.begin(), tokens.end());
+                        output.push_back(GAME_END);
+                        counters.converted_games++;
+                    }
+                    continue;
+                }
+                counters.invalid_games++;
+                // a variation left open by a malformed move is not an error of its own
+                const bool replay_error = !played && (parsed || bad_token < tokens.size());
+                if( replay_error ) {
+                    message = replay_message;
+                } else {
+                    ply = board.get_ply() + 1;
+                }
+                if( !compact ) {
+                    const GameText& text = texts[game - 1];
+                    if( replay_error ) {
+                        error_offset = (bad_token < offsets.size()) ? offsets[bad_token] : text.end - text.begin;
+                    }
+                    line += count_lines(data + text.begin, data + text.begin + error_offset);
+                }
+                report(file.path, line, ply, message);
+            }
+
+            if( convert_dir.empty() || output.empty() ) {
+                return;
+            }
+            const std::string out_path = convert_dir + "/" + file.relative + COMPACT_SUFFIX;
+            make_parent_dirs(out_path);
+            std::ofstream out(out_path.c_str(), std::ios::binary | std::ios::trunc);
+            out.write(COMPACT_MAGIC, magic_size);
+            for(auto token=output.begin(); token!=output.end(); token++) {
+                const char bytes[2] = { static_cast<char>(*token & 0xFF), static_cast<char>(*token >> 8) };
+                out.write(bytes, 2);
+            }
+            if( !out.flush() ) {
+                report(out_path, 0, 0, "can't write converted games");
+            }
+        });
+    }
+    pool.wait();
+
+    GameValidatorStats stats = { counters.files.load(), counters.games.load(), counters.moves.load(),
+                                 counters.bytes.load(), counters.invalid_games.load(),
+                                 counters.converted_games.load() };
+    return stats;
+}
@@ -0,0 +1,76 @@
+#ifndef GAMEVALIDATOR_H
+#define GAMEVALIDATOR_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "chessboard.h"
+
+/*
+ *  GameValidator - checks trees of saved game files on a thread pool.
+ *
+ *  A file is one game in ChessBoard::save_game format, variations included, or with
+ *  one_per_line every non empty line is a game (archives of the other tools). Files are
+ *  memory mapped & parsed in place, moves are replayed on a ChessBoard per worker, so
+ *  "valid" means ChessBoard::load_game accepts the game. Every bad game is reported with
+ *  the line & ply of its first bad move.
+ *
+ *  Valid games can be converted in the same pass into the compact format:
+ *  COMPACT_MAGIC, then every game as little endian 16 bit tokens ended by GAME_END,
+ *  a token is a PackedMove or a variation bracket. Compact files are validated as well.
+ */
+
+struct GameIssue
+{
+    std::string file;
+    size_t line;                //from 1, game number in compact files
+    int ply;                    //of the bad move from the start position, 0 if not a move
+    std::string message;
+};
+
+struct GameValidatorStats
+{
+    uint64_t files;
+    uint64_t games;
+    uint64_t moves;
+    uint64_t bytes;
+    uint64_t invalid_games;
+    uint64_t converted_games;
+};
+
+class GameValidator
+{
+public:
+    static const uint16_t VARIATION_START = 0xF000;
+    static const uint16_t VARIATION_END = 0xF001;
+    static const uint16_t GAME_END = 0xF002;
+    static const char COMPACT_MAGIC[];          //8 bytes
+    static const char COMPACT_SUFFIX[];
+
+    //called from the workers, one call at a time
+    typedef std::function<void(const GameIssue& issue)> IssueCallback;
+
+    explicit GameValidator(int threads);
+
+    //paths - files & directories, directories are walked recursively
+    //convert_dir - where valid games go in compact format under the same relative paths plus COMPACT_SUFFIX,
+    //empty - no conversion
+    GameValidatorStats validate(const std::vector<std::string>& paths, bool one_per_line,
+                                const std::string& convert_dir, const IssueCallback& callback);
+
+    //"[e2,e4] ( [d2,d4] ) [e7,e5] " into tokens, @ret false with offset of the malformed part
+    static bool parse_text(const char* begin, const char* end, std::vector<uint16_t>& tokens,
+                           std::vector<size_t>& offsets, size_t& error_offset, std::string& message);
+    //plays tokens on the board from the start position like ChessBoard::load_game,
+    //@ret false with the index of the bad token & its ply
+    static bool replay(const std::vector<uint16_t>& tokens, ChessBoard& board, size_t& bad_token, int& ply,
+                       std::string& message);
+
+    int threads_count() const                           {   return m_threads;   }
+private:
+    int m_threads;
+};
+
+#endif // GAMEVALIDATOR_H
@@ -0,0 +1,281 @@
+#include "instrumentation.h"
+
+#include <fstream>
+#include <iomanip>
+
+#ifdef CHESS_INSTRUMENTATION
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#endif
+
+static const char* PROBE_NAMES[] = {
+    "move_validation",
+    "make_move",
+    "undo",
+    "redo",
+    "save_game",
+    "load_game",
+    "file_save",
+    "file_load",
+    "journal_append",
+    "journal_commit",
+    "update_cells",
+    "update_model",
+    "search",
+    "search_nodes",
+    "tt_hit",
+    "analysis_cache_hit",
+    "pawn_probe",
+    "pawn_hit"
+};
+
+static const int PROBES = static_cast<int>(Probe::PROBES_COUNT);
+static_assert(sizeof(PROBE_NAMES)/sizeof(PROBE_NAMES[0]) == PROBES, "every probe needs a name");
+
+const char* Instrumentation::probe_name(Probe probe)
+{
+    return PROBE_NAMES[static_cast<int>(probe)];
+}
+
+#ifdef CHESS_INSTRUMENTATION
+
+/*
+ *  Per-thread storage: counters are written by the owner thread only,
+ *  so relaxed load/store is enough & costs no locked instruction
+ */
+
+struct TraceEvent
+{
+    uint32_t tid;
+    uint32_t probe;
+    uint64_t start_ns;
+    uint64_t dur_ns;
+};
+
+//ring buffer size per thread, the oldest events are overwritten
+static const size_t TRACE_CAPACITY = 1 << 16;
+
+struct ThreadProbes
+{
+    ThreadProbes();
+    ~ThreadProbes();
+
+    std::atomic<uint64_t> counts[PROBES];
+    std::atomic<uint64_t> totals[PROBES];
+
+    std::mutex trace_mutex;
+    std::vector<TraceEvent> trace;
+    size_t trace_pos;
+    uint32_t tid;
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<ThreadProbes*> threads;
+    uint64_t retired_counts[PROBES];
+    uint64_t retired_totals[PROBES];
+    std::vector<TraceEvent> retired_trace;
+    std::atomic<bool> tracing;
+    uint32_t next_tid;
+
+    Registry():
+        tracing(false), next_tid(1)
+    {
+        std::fill_n(retired_counts, PROBES, 0);
+        std::fill_n(retired_totals, PROBES, 0);
+    }
+};
+
+static Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+static void collect_trace(ThreadProbes& probes, std::vector<TraceEvent>& out)
+{
+    std::lock_guard<std::mutex> lock(probes.trace_mutex);
+    // oldest events first
+    if( probes.trace.size() == TRACE_CAPACITY ) {
+        out.insert(out.end(), probes.trace.begin() + probes.trace_pos, probes.trace.end());
+        out.insert(out.end(), probes.trace.begin(), probes.trace.begin() + probes.trace_pos);
+    } else {
+        out.insert(out.end(), probes.trace.begin(), probes.trace.end());
+    }
+}
+
+ThreadProbes::ThreadProbes():
+    trace_pos(0)
+{
+    for(int i=0; i<PROBES; i++) {
+        counts[i].store(0, std::memory_order_relaxed);
+        totals[i].store(0, std::memory_order_relaxed);
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    tid = reg.next_tid++;
+    reg.threads.push_back(this);
+}
+
+ThreadProbes::~ThreadProbes()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for(int i=0; i<PROBES; i++) {
+        reg.retired_counts[i] += counts[i].load(std::memory_order_relaxed);
+        reg.retired_totals[i] += totals[i].load(std::memory_order_relaxed);
+    }
+    if( reg.retired_trace.size() < TRACE_CAPACITY ) {
+        collect_trace(*this, reg.retired_trace);
+    }
+    reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), this));
+}
+
+static ThreadProbes& local_probes()
+{
+    thread_local ThreadProbes probes;
+    return probes;
+}
+
+inline void relaxed_add(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*
+ *  Instrumentation implementation
+ */
+
+bool Instrumentation::is_enabled()
+{
+    return true;
+}
+
+uint64_t Instrumentation::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Instrumentation::add(Probe probe, uint64_t count)
+{
+    relaxed_add(local_probes().counts[static_cast<int>(probe)], count);
+}
+
+void Instrumentation::record(Probe probe, uint64_t start_ns, uint64_t end_ns)
+{
+    ThreadProbes& probes = local_probes();
+    const int ind = static_cast<int>(probe);
+    relaxed_add(probes.counts[ind], 1);
+    relaxed_add(probes.totals[ind], end_ns - start_ns);
+
+    if( registry().tracing.load(std::memory_order_relaxed) ) {
+        TraceEvent event = { probes.tid, static_cast<uint32_t>(ind), start_ns, end_ns - start_ns };
+        std::lock_guard<std::mutex> lock(probes.trace_mutex);
+        if( probes.trace.size() < TRACE_CAPACITY ) {
+            probes.trace.push_back(event);
+        } else {
+            probes.trace[probes.trace_pos] = event;
+            probes.trace_pos = (probes.trace_pos + 1) % TRACE_CAPACITY;
+        }
+    }
+}
+
+std::vector<ProbeStats> Instrumentation::snapshot()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::vector<ProbeStats> res(PROBES);
+    for(int i=0; i<PROBES; i++) {
+        res[i].name = PROBE_NAMES[i];
+        res[i].count = reg.retired_counts[i];
+        res[i].total_ns = reg.retired_totals[i];
+        for(auto iter=reg.threads.begin(); iter!=reg.threads.end(); iter++) {
+            res[i].count += (*iter)->counts[i].load(std::memory_order_relaxed);
+            res[i].total_ns += (*iter)->totals[i].load(std::memory_order_relaxed);
+        }
+    }
+    return res;
+}
+
+void Instrumentation::reset()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::fill_n(reg.retired_counts, PROBES, 0);
+    std::fill_n(reg.retired_totals, PROBES, 0);
+    reg.retired_trace.clear();
+    for(auto iter=reg.threads.begin(); iter!=reg.threads.end(); iter++) {
+        for(int i=0; i<PROBES; i++) {
+            (*iter)->counts[i].store(0, std::memory_order_relaxed);
+            (*iter)->totals[i].store(0, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> trace_lock((*iter)->trace_mutex);
+        (*iter)->trace.clear();
+        (*iter)->trace_pos = 0;
+    }
+}
+
+void Instrumentation::set_tracing(bool on)
+{
+    registry().tracing.store(on);
+}
+
+bool Instrumentation::export_trace(const std::string& file)
+{
+    std::vector<TraceEvent> events;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        events = reg.retired_trace;
+        for(auto iter=reg.threads.begin(); iter!=reg.threads.end(); iter++) {
+            collect_trace(**iter, events);
+        }
+    }
+
+    std::ofstream out(file.c_str());
+    if( !out ) {
+        return false;
+    }
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    for(size_t i=0; i<events.size(); i++) {
+        const TraceEvent& e = events[i];
+        out << "{\"name\":\"" << PROBE_NAMES[e.probe] << "\",\"cat\":\"chess\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+            << ",\"ts\":" << e.start_ns / 1000.0 << ",\"dur\":" << e.dur_ns / 1000.0 << "}"
+            << (i+1 < events.size() ? ",\n" : "\n");
+    }
+    out << "],\"displayTimeUnit\":\"ns\"}\n";
+    return out.good();
+}
+
+#else
+
+bool Instrumentation::is_enabled()
+{
+    return false;
+}
+
+std::vector<ProbeStats> Instrumentation::snapshot()
+{
+    return std::vector<ProbeStats>();
+}
+
+void Instrumentation::reset()
+{}
+
+void Instrumentation::set_tracing(bool on)
+{
+    (void)on;
+}
+
+bool Instrumentation::export_trace(const std::string& file)
+{
+    (void)file;
+    return false;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ *  Hot path instrumentation: per-thread counters & scoped timers.
+ *
+ *  Compiled in only with CHESS_INSTRUMENTATION defined (qmake CONFIG+=instrumentation),
+ *  otherwise probes expand to nothing and the API returns empty results.
+ *  Trace events for Chrome trace / Perfetto are recorded only while tracing is on.
+ */
+
+enum class Probe
+{
+    MOVE_VALIDATION = 0,
+    MAKE_MOVE,
+    UNDO,
+    REDO,
+    SAVE_GAME,
+    LOAD_GAME,
+    FILE_SAVE,
+    FILE_LOAD,
+    JOURNAL_APPEND,
+    JOURNAL_COMMIT,
+    UPDATE_CELLS,
+    UPDATE_MODEL,
+    SEARCH,
+    SEARCH_NODES,
+    TT_HIT,
+    CACHE_HIT,
+    PAWN_PROBE,
+    PAWN_HIT,
+    PROBES_COUNT
+};
+
+struct ProbeStats
+{
+    const char* name;
+    uint64_t count;
+    uint64_t total_ns;
+};
+
+class Instrumentation
+{
+public:
+    static bool is_enabled();
+
+    //sums over all threads, including finished ones
+    static std::vector<ProbeStats> snapshot();
+    static void reset();
+
+    static void set_tracing(bool on);
+    //Chrome trace event format, loads in chrome://tracing & Perfetto
+    static bool export_trace(const std::string& file);
+
+    static const char* probe_name(Probe probe);
+
+#ifdef CHESS_INSTRUMENTATION
+    static uint64_t now_ns();
+    static void add(Probe probe, uint64_t count);
+    static void record(Probe probe, uint64_t start_ns, uint64_t end_ns);
+#endif
+};
+
+#ifdef CHESS_INSTRUMENTATION
+
+class ScopedProbe
+{
+public:
+    explicit ScopedProbe(Probe probe):
+        m_probe(probe), m_start(Instrumentation::now_ns())
+    {}
+    ~ScopedProbe()
+    {
+        Instrumentation::record(m_probe, m_start, Instrumentation::now_ns());
+    }
+private:
+    ScopedProbe(const ScopedProbe&);
+    ScopedProbe& operator=(const ScopedProbe&);
+
+    Probe m_probe;
+    uint64_t m_start;
+};
+
+#define PROBE_CONCAT_IMPL(a, b) a##b
+#define PROBE_CONCAT(a, b) PROBE_CONCAT_IMPL(a, b)
+#define PROBE_SCOPE(probe) ScopedProbe PROBE_CONCAT(probe_scope_, __LINE__)(probe)
+#define PROBE_COUNT(probe, n) Instrumentation::add(probe, n)
+
+#else
+
+#define PROBE_SCOPE(probe) ((void)0)
+#define PROBE_COUNT(probe, n) ((void)0)
+
+#endif
+
+#endif // INSTRUMENTATION_H
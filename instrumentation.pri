@@ -0,0 +1,7 @@
+# Hot path probes are compiled in with: qmake CONFIG+=instrumentation
+instrumentation {
+    DEFINES += CHESS_INSTRUMENTATION
+}
+
+SOURCES += $$PWD/instrumentation.cpp
+HEADERS += $$PWD/instrumentation.h
@@ -1,15 +1,21 @@
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QtQml>
 #include "chessfieldmodel.h"
+#include "pieceimageprovider.h"
+#include "chessboarditem.h"
 
 
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
-    ChessFieldModel chess_model;
+    qmlRegisterType<ChessBoardItem>("Chess", 1, 0, "ChessBoardItem");
+    ChessFieldModel chess_model(AnalysisCache::default_path());
 
     QQmlApplicationEngine engine;
+    //engine takes ownership
+    engine.addImageProvider("pieces", new PieceImageProvider);
     QQmlContext *ctxt = engine.rootContext();
     ctxt->setContextProperty("chess_board_model", &chess_model);
 
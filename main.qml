@@ -2,12 +2,13 @@ import QtQuick 2.2
 import QtQuick.Window 2.1
 import QtQuick.Controls 1.2
 import QtQuick.Dialogs 1.2
+import Chess 1.0
 
 Window {
     visible: true
     id: main_window
 
-    width: 600
+    width: 800
     height: 480
 
     minimumWidth: width
@@ -27,79 +28,17 @@ Window {
         anchors.left : parent.left
         anchors.top : parent.top
 
-        Component {
-            id : board_part
-            Item {
-                id : wrapper
-                width : chess_field.cellWidth
-                height : chess_field.cellHeight
-
-                Rectangle {
-                    id : board_piece
-                    anchors.fill: parent
-                    color : cell_color
-                }
-                Image {
-                    id : chess_piece
-                    source: image_path
-                    width : chess_field.cellWidth
-                    height : chess_field.cellHeight
-                    smooth : true
-                    cache : false
-                    fillMode : Image.PreserveAspectFit
-                }
-                states : [
-                    State {
-                        name : "selected"
-                        when : chess_field.selected_cell == index
-                        PropertyChanges { target : dragged_item; source :  chess_board_model.get(index).image_path;
-                                          x : mouse.mouseX - width / 2 + chess_board.x + chess_field.x
-                                          y: mouse.mouseY - height / 2 + chess_board.y + chess_field.y
-                        }
-                        PropertyChanges { target : chess_piece; source :  "" }
-                    }
-                ]
-            }
-        }
-
-        GridView {
+        ChessBoardItem {
             id : chess_field
-            delegate : board_part
             model : chess_board_model
+            enabled : !chess_board_model.file_busy
             height : 380
             width : 380
-            readonly property int rows_count: 8
-            readonly property int cols_count: 8
-            cellHeight : height / rows_count
-            cellWidth: width / cols_count
-
-            interactive: false
 
             anchors.left: parent.left
             anchors.top: parent.top
             anchors.topMargin: 20
             anchors.leftMargin: 20 + cellWidth / 2
-
-            property int selected_cell : -1
-
-            MouseArea {
-                id : mouse
-                anchors.fill : parent
-                drag { maximumX: width; maximumY: height }
-
-                property int dest_ind
-
-                onPressed : {
-                    chess_field.selected_cell = chess_field.indexAt(mouseX, mouseY)
-                }
-                onReleased : {
-                    dest_ind = chess_field.indexAt(mouseX, mouseY)
-                    if(chess_field.selected_cell != -1 && dest_ind != -1 && dest_ind != chess_field.selected_cell) {
-                        chess_board_model.make_move(chess_field.selected_cell, dest_ind);
-                    }
-                    chess_field.selected_cell = -1
-                }
-            }
         }
 
         Row {
@@ -135,12 +74,37 @@ Window {
              BoardSign { width : parent.width; height : chess_field.cellHeight/2; cln_name: "" }
          }
 
+        Rectangle {
+            id : file_panel
+            color : "lightgrey"
+            height : 30
+            visible : chess_board_model.file_busy
+            anchors { left: chess_field.left; right: chess_field.right; verticalCenter: chess_field.verticalCenter }
+
+            ProgressBar {
+                anchors { left: parent.left; right: file_cancel_btn.left; verticalCenter: parent.verticalCenter; margins : 5 }
+                minimumValue : 0
+                maximumValue : 1
+                indeterminate : chess_board_model.file_progress < 0
+                value : Math.max(chess_board_model.file_progress, 0)
+            }
+            Button {
+                id : file_cancel_btn
+                text : "Cancel"
+                width : 60
+                // saving always completes
+                enabled : chess_board_model.file_progress >= 0
+                anchors { right: parent.right; verticalCenter: parent.verticalCenter; margins : 5 }
+                onClicked : chess_board_model.cancel_file_task()
+            }
+        }
    }
 
    Button {
        id : start_btn
        text : "Start"
        width : 80
+       enabled : !chess_board_model.file_busy
        anchors { top: parent.top; left: chess_board.right; margins : 20 }
 
        function start_new_game(){
@@ -172,6 +136,7 @@ Window {
        text : "Load"
        id : load_btn
        width : 80
+       enabled : !chess_board_model.file_busy
        anchors { top: start_btn.bottom; left: chess_board.right; margins : 20 }
        function load_game() {
            load_file_dialog.open()
@@ -200,6 +165,7 @@ Window {
        text : "Prev"
        id : prev_btn
        width : 80
+       enabled : !chess_board_model.file_busy
        anchors { top: load_btn.bottom; left: chess_board.right; margins : 20 }
        onClicked : {
            chess_board_model.undo()
@@ -218,6 +184,7 @@ Window {
        text : "Next"
        id : next_btn
        width : 80
+       enabled : !chess_board_model.file_busy
        anchors { top: prev_btn.bottom; left: chess_board.right; margins : 20 }
        onClicked : {
            chess_board_model.redo()
@@ -231,16 +198,164 @@ Window {
        ]
    }
 
-   Item {
-       id : dragged_piece
-       Image {
-           id : dragged_item
-           width : chess_field.cellWidth;
-           height : chess_field.cellHeight
-           source : ""
+   Row {
+       id : variation_row
+       spacing : 5
+       anchors { top: next_btn.bottom; left: chess_board.right; margins : 20 }
+       visible : main_window.current_screen != 1 && chess_board_model.variations_count > 1
+       enabled : !chess_board_model.file_busy
+
+       Button {
+           text : "<"
+           width : 25
+           onClicked : chess_board_model.prev_variation()
+       }
+       Text {
+           anchors.verticalCenter : parent.verticalCenter
+           text : (chess_board_model.variation_index + 1) + "/" + chess_board_model.variations_count
+       }
+       Button {
+           text : ">"
+           width : 25
+           onClicked : chess_board_model.next_variation()
+       }
+   }
+
+   Text {
+       id : draw_text
+       width : 120
+       wrapMode : Text.WordWrap
+       anchors { top: variation_row.bottom; left: chess_board.right; margins : 20 }
+       visible : main_window.current_screen != 1 && chess_board_model.draw_reason != ""
+       text : "Draw: " + chess_board_model.draw_reason
+   }
+
+   Column {
+       id : clock_column
+       width : 120
+       anchors { top: draw_text.bottom; left: chess_board.right; margins : 20 }
+       visible : chess_board_model.engine_side >= 0 || engine_result.text != ""
+
+       Text {
+           visible : chess_board_model.engine_side >= 0
+           text : "White " + chess_board_model.white_clock
+       }
+       Text {
+           visible : chess_board_model.engine_side >= 0
+           text : "Black " + chess_board_model.black_clock
+       }
+       Text {
+           id : engine_result
+           width : parent.width
+           wrapMode : Text.WordWrap
+           text : ""
+       }
+   }
+
+   Button {
+       text : "Index"
+       id : index_btn
+       width : 80
+       anchors { top: parent.top; left: start_btn.right; margins : 20 }
+       onClicked : {
+           index_file_dialog.open()
        }
    }
 
+   Button {
+       text : analysis_panel.running ? "Stop" : "Analyse"
+       id : analyse_btn
+       width : 80
+       anchors { top: parent.top; left: index_btn.right; margins : 20 }
+       onClicked : {
+           if( analysis_panel.running ) {
+               chess_board_model.stop_analysis()
+           } else {
+               chess_board_model.start_analysis(analysis_panel.lines_count)
+           }
+           analysis_panel.running = !analysis_panel.running
+       }
+   }
+
+   Button {
+       text : chess_board_model.engine_side >= 0 ? "Resign" : "Play"
+       id : engine_btn
+       width : 80
+       enabled : !chess_board_model.file_busy
+       anchors { top: parent.top; left: analyse_btn.right; margins : 20 }
+       // engine takes black, 5 minutes + 3 seconds a move, thinks on the opponent's time
+       onClicked : {
+           if( chess_board_model.engine_side >= 0 ) {
+               chess_board_model.stop_engine_game()
+               engine_result.text = "Resigned"
+           } else {
+               engine_result.text = ""
+               chess_board_model.start_engine_game(0, 5, 3, true)
+           }
+       }
+   }
+
+   Rectangle {
+       id : explorer_panel
+       color : "lightgrey"
+       anchors { top: index_btn.bottom; left: index_btn.left; right: parent.right; bottom: parent.verticalCenter; margins : 20; leftMargin : 0 }
+
+       Text {
+           id : explorer_title
+           anchors { top: parent.top; left: parent.left; margins : 5 }
+           text : "Games: " + chess_board_model.explorer_games
+           font.bold : true
+       }
+       ListView {
+           anchors { top: explorer_title.bottom; left: parent.left; right: parent.right; bottom: parent.bottom; margins : 5 }
+           clip : true
+           model : chess_board_model.explorer
+           delegate : Text {
+               text : modelData.move + "   " + modelData.count + " (" + modelData.percent + "%)"
+           }
+       }
+   }
+
+   Rectangle {
+       id : analysis_panel
+       color : "lightgrey"
+       anchors { top: explorer_panel.bottom; left: explorer_panel.left; right: parent.right; bottom: parent.bottom; margins : 20; leftMargin : 0 }
+
+       property bool running : false
+       readonly property int lines_count : 3
+
+       Text {
+           id : analysis_title
+           anchors { top: parent.top; left: parent.left; margins : 5 }
+           text : "Depth: " + chess_board_model.analysis_depth
+           font.bold : true
+       }
+       ListView {
+           anchors { top: analysis_title.bottom; left: parent.left; right: parent.right; bottom: parent.bottom; margins : 5 }
+           clip : true
+           model : chess_board_model.analysis
+           delegate : Text {
+               width : parent.width
+               elide : Text.ElideRight
+               text : (index + 1) + ". " + modelData.score + "   " + modelData.pv
+           }
+       }
+   }
+
+   Connections {
+       target : chess_board_model
+       onFile_task_finished : {
+           if( !ok ) {
+               console.log("File operation failed or was cancelled")
+           }
+       }
+       onEngine_game_finished : {
+           engine_result.text = result
+       }
+       onJournal_failed : {
+           console.log("Journal compaction failed, save the game to keep it safe")
+       }
+   }
 
    FileDialog {
        id: load_file_dialog
@@ -270,6 +385,16 @@ Window {
        }
    }
 
+   FileDialog {
+       id: index_file_dialog
+       title: "Please choose position index"
+       selectExisting : true
+       selectMultiple : false
+       onAccepted: {
+           chess_board_model.open_position_index(index_file_dialog.fileUrl)
+       }
+   }
+
    property int current_screen: 1
 
 }
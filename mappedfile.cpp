@@ -0,0 +1,103 @@
+#include "mappedfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile():
+    m_data(NULL), m_size(0), m_writable(false)
+{}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+        return false;
+    }
+    struct stat st;
+    if( fstat(fd, &st) != 0 || st.st_size == 0 ) {
+        ::close(fd);
+        return false;
+    }
+    return map(fd, st.st_size, false);
+}
+
+bool MappedFile::open_writable(const std::string& path, size_t min_size)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if( fd < 0 ) {
+        return false;
+    }
+    struct stat st;
+    if( fstat(fd, &st) != 0 ) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    if( size < min_size ) {
+        // sparse extension, new pages read as zeros
+        if( ftruncate(fd, min_size) != 0 ) {
+            ::close(fd);
+            return false;
+        }
+        size = min_size;
+    }
+    if( size == 0 ) {
+        ::close(fd);
+        return false;
+    }
+    return map(fd, size, true);
+}
+
+bool sync_parent_dir(const std::string& path)
+{
+    const size_t pos = path.find_last_of('/');
+    const std::string dir = (pos == std::string::npos) ? std::string(".") :
+                            (pos == 0 ? std::string("/") : path.substr(0, pos));
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if( fd < 0 ) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool MappedFile::map(int fd, size_t size, bool writable)
+{
+    void* addr = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    // mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if( addr == MAP_FAILED ) {
+        return false;
+    }
+    m_data = static_cast<const char*>(addr);
+    m_size = size;
+    m_writable = writable;
+    return true;
+}
+
+bool MappedFile::flush()
+{
+    return m_writable && msync(const_cast<char*>(m_data), m_size, MS_ASYNC) == 0;
+}
+
+void MappedFile::close()
+{
+    if( m_data ) {
+        munmap(const_cast<char*>(m_data), m_size);
+        m_data = NULL;
+        m_size = 0;
+        m_writable = false;
+    }
+}
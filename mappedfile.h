@@ -0,0 +1,42 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <cstddef>
+
+/*
+ *  MappedFile - memory mapping of a whole file, read-only or shared read-write
+ */
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    //file is created (or extended) to min_size bytes, writes go to the file through the page cache
+    bool open_writable(const std::string& path, size_t min_size);
+    void close();
+    //schedules dirty pages for writing back, doesn't wait for the disk
+    bool flush();
+
+    bool is_open() const                        {   return m_data != NULL;  }
+    const char* data() const                    {   return m_data;  }
+    char* writable_data() const                 {   return m_writable ? const_cast<char*>(m_data) : NULL;  }
+    size_t size() const                         {   return m_size;  }
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    bool map(int fd, size_t size, bool writable);
+
+    const char* m_data;
+    size_t m_size;
+    bool m_writable;
+};
+
+//makes creation or renaming of path durable by syncing the directory it is in
+bool sync_parent_dir(const std::string& path);
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,184 @@
+#include "pawntable.h"
+
+#include <algorithm>
+
+/*
+ *  Auxiliary functions
+ */
+
+static const int DOUBLED_PENALTY = -12;         //every pawn with an own pawn in front of it
+static const int ISOLATED_PENALTY = -12;
+static const int BACKWARD_PENALTY = -8;
+//by row from the pawn's own side
+static const int PASSED_BONUS[8]      = { 0, 5, 10, 20, 35, 60, 100, 0 };
+static const int PASSED_FREE_BONUS[8] = { 0, 0,  5, 10, 15, 25,  40, 0 };
+//own pawns one & two rows in front of the king
+static const int SHIELD_BONUS[2] = { 10, 5 };
+
+inline uint64_t square_bit(int r, int c)
+{
+    return uint64_t(1) << (r*8 + c);
+}
+
+inline uint64_t file_mask(int c)
+{
+    return (c < 0 || c > 7) ? 0 : uint64_t(0x0101010101010101) << c;
+}
+
+//rows >= r
+inline uint64_t rows_from(int r)
+{
+    return r > 7 ? 0 : ~uint64_t(0) << (std::max(r, 0)*8);
+}
+
+//rows <= r
+inline uint64_t rows_to(int r)
+{
+    return ~rows_from(r + 1);
+}
+
+inline uint64_t row_mask(int r)
+{
+    return (r < 0 || r > 7) ? 0 : uint64_t(0xFF) << (r*8);
+}
+
+//rows closer to the promotion row of side
+inline uint64_t rows_in_front(int side, int r)
+{
+    return side == Position::WHITE ? rows_from(r + 1) : rows_to(r - 1);
+}
+
+/*
+ *  PawnTable implementation
+ */
+
+const size_t PawnTable::DEFAULT_ENTRIES;
+
+PawnTable::PawnTable(size_t entries)
+{
+    size_t size = 1;
+    while( size * 2 <= entries ) {
+        size *= 2;
+    }
+    m_entries.resize(size);
+    clear();
+}
+
+void PawnTable::clear()
+{
+    // key 0 is the board without pawns, a zeroed entry is already right for it
+    Entry empty = { 0, { 0, 0 }, { 0, 0 }, 0 };
+    std::fill(m_entries.begin(), m_entries.end(), empty);
+    m_probes = 0;
+    m_hits = 0;
+}
+
+int PawnTable::evaluate(const Position& pos)
+{
+    const Entry& entry = probe(pos);
+    int res = entry.score;
+    for(int side=Position::BLACK; side<=Position::WHITE; side++) {
+        const int sign = (side == Position::WHITE) ? 1 : -1;
+        const int dir = sign;
+        const int king_sq = pos.king_square(side);
+        if( king_sq >= 0 ) {
+            res += sign * shield(entry, side, king_sq);
+        }
+        if( entry.passed[side] == 0 ) {
+            continue;
+        }
+        // passed pawns with nothing on the way one step ahead
+        for(int sq=0; sq<Position::SQUARES; sq++) {
+            if( !(entry.passed[side] & (uint64_t(1) << sq)) ) {
+                continue;
+            }
+            const int stop = sq + dir*8;
+            if( stop >= 0 && stop < Position::SQUARES && pos.get(stop) == ChessPiece::NONE ) {
+                const int rank = (side == Position::WHITE) ? sq/8 : 7 - sq/8;
+                res += sign * PASSED_FREE_BONUS[rank];
+            }
+        }
+    }
+    return (pos.get_side() == Position::WHITE) ? res : -res;
+}
+
+const PawnTable::Entry& PawnTable::probe(const Position& pos)
+{
+    const uint64_t key = pos.get_pawn_hash();
+    Entry& entry = m_entries[key & (m_entries.size() - 1)];
+    m_probes++;
+    if( entry.key == key ) {
+        m_hits++;
+        return entry;
+    }
+    entry.key = key;
+    compute(pos, entry);
+    return entry;
+}
+
+void PawnTable::compute(const Position& pos, Entry& entry)
+{
+    entry.pawns[Position::BLACK] = entry.pawns[Position::WHITE] = 0;
+    for(int sq=0; sq<Position::SQUARES; sq++) {
+        if( pos.get(sq) == ChessPiece::WT_PAWN ) {
+            entry.pawns[Position::WHITE] |= uint64_t(1) << sq;
+        } else if( pos.get(sq) == ChessPiece::BK_PAWN ) {
+            entry.pawns[Position::BLACK] |= uint64_t(1) << sq;
+        }
+    }
+
+    entry.score = 0;
+    for(int side=Position::BLACK; side<=Position::WHITE; side++) {
+        const uint64_t own = entry.pawns[side];
+        const uint64_t opp = entry.pawns[1 - side];
+        const int dir = (side == Position::WHITE) ? 1 : -1;
+        int score = 0;
+        entry.passed[side] = 0;
+        for(int r=0; r<8; r++) {
+            for(int c=0; c<8; c++) {
+                if( !(own & square_bit(r, c)) ) {
+                    continue;
+                }
+                const uint64_t front = rows_in_front(side, r);
+                const uint64_t adjacent = file_mask(c-1) | file_mask(c+1);
+                if( own & file_mask(c) & front ) {
+                    score += DOUBLED_PENALTY;
+                }
+                if( !(own & adjacent) ) {
+                    score += ISOLATED_PENALTY;
+                } else if( !(own & adjacent & ~front) ) {
+                    // neighbours are all ahead & an enemy pawn guards the square in front
+                    if( opp & adjacent & row_mask(r + 2*dir) ) {
+                        score += BACKWARD_PENALTY;
+                    }
+                }
+                if( !(opp & (adjacent | file_mask(c)) & front) && !(own & file_mask(c) & front) ) {
+                    entry.passed[side] |= square_bit(r, c);
+                    score += PASSED_BONUS[(side == Position::WHITE) ? r : 7 - r];
+                }
+            }
+        }
+        entry.score += (side == Position::WHITE) ? score : -score;
+    }
+}
+
+int PawnTable::shield(const Entry& entry, int side, int king_sq)
+{
+    const int r = king_sq / 8, c = king_sq % 8;
+    const int dir = (side == Position::WHITE) ? 1 : -1;
+    const int home = (side == Position::WHITE) ? r : 7 - r;
+    if( home > 1 ) {
+        return 0;
+    }
+    const uint64_t files = file_mask(c-1) | file_mask(c) | file_mask(c+1);
+    int res = 0;
+    for(int i=0; i<2; i++) {
+        const uint64_t shield = entry.pawns[side] & files & row_mask(r + (i+1)*dir);
+        for(int f=0; f<8; f++) {
+            if( shield & file_mask(f) ) {
+                res += SHIELD_BONUS[i];
+            }
+        }
+    }
+    return res;
+}
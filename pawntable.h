@@ -0,0 +1,53 @@
+#ifndef PAWNTABLE_H
+#define PAWNTABLE_H
+
+#include <vector>
+#include <cstdint>
+
+#include "position.h"
+
+/*
+ *  PawnTable - pawn structure scores cached by Position::get_pawn_hash().
+ *
+ *  Pawns move rarely compared to other pieces, so most positions of a search share
+ *  a handful of pawn structures. An entry keeps the structure score (doubled, isolated,
+ *  backward & passed pawns) and the pawn & passed pawn masks, king shields are
+ *  counted from the masks on every call since kings move more often than pawns.
+ *  Not thread safe, every Searcher owns one.
+ */
+
+class PawnTable
+{
+public:
+    static const size_t DEFAULT_ENTRIES = 1 << 13;
+
+    //entries - rounded down to a power of 2
+    explicit PawnTable(size_t entries = DEFAULT_ENTRIES);
+
+    //pawn structure & king shields from side to move point of view, in centipawns
+    int evaluate(const Position& pos);
+
+    uint64_t probes() const                             {   return m_probes;   }
+    uint64_t hits() const                               {   return m_hits;   }
+    void clear();
+private:
+    //masks are bit per square, row*8+column
+    struct Entry
+    {
+        uint64_t key;
+        uint64_t pawns[2];          //indexed by Position::BLACK/WHITE
+        uint64_t passed[2];
+        int score;                  //white point of view
+    };
+
+    const Entry& probe(const Position& pos);
+    static void compute(const Position& pos, Entry& entry);
+    //own pawns in front of a king standing on its first two rows
+    static int shield(const Entry& entry, int side, int king_sq);
+
+    std::vector<Entry> m_entries;
+    uint64_t m_probes;
+    uint64_t m_hits;
+};
+
+#endif // PAWNTABLE_H
@@ -0,0 +1,97 @@
+#include "pieceimageprovider.h"
+#include "chesspiecemove.h"
+
+#include <QPainter>
+#include <QMutexLocker>
+#include <QVector>
+
+static const int PIECES = to_int(ChessPiece::PIECES_COUNT);
+static const int DEFAULT_CELL_SIZE = 48;
+
+//decoded at source resolution once per process, index is ChessPiece
+static const QVector<QImage>& sprites()
+{
+    static QVector<QImage> images = [] {
+        QVector<QImage> res(PIECES);
+        res[to_int(ChessPiece::WT_KING)]   = QImage(":/img/assets/wt_king.png");
+        res[to_int(ChessPiece::WT_QUEEN)]  = QImage(":/img/assets/wt_queen.png");
+        res[to_int(ChessPiece::WT_BISHOP)] = QImage(":/img/assets/wt_bishop.png");
+        res[to_int(ChessPiece::WT_KNIGHT)] = QImage(":/img/assets/wt_knight.png");
+        res[to_int(ChessPiece::WT_CASTLE)] = QImage(":/img/assets/wt_castle.png");
+        res[to_int(ChessPiece::WT_PAWN)]   = QImage(":/img/assets/wt_pawn.png");
+
+        res[to_int(ChessPiece::BK_KING)]   = QImage(":/img/assets/bk_king.png");
+        res[to_int(ChessPiece::BK_QUEEN)]  = QImage(":/img/assets/bk_queen.png");
+        res[to_int(ChessPiece::BK_BISHOP)] = QImage(":/img/assets/bk_bishop.png");
+        res[to_int(ChessPiece::BK_KNIGHT)] = QImage(":/img/assets/bk_knight.png");
+        res[to_int(ChessPiece::BK_CASTLE)] = QImage(":/img/assets/bk_castle.png");
+        res[to_int(ChessPiece::BK_PAWN)]   = QImage(":/img/assets/bk_pawn.png");
+        return res;
+    }();
+    return images;
+}
+
+const int PieceImageProvider::MAX_ATLASES;
+
+PieceImageProvider::PieceImageProvider():
+    QQuickImageProvider(QQuickImageProvider::Image)
+{
+    atlas(QSize(DEFAULT_CELL_SIZE, DEFAULT_CELL_SIZE));
+}
+
+QImage PieceImageProvider::render_atlas(const QSize& cell_size)
+{
+    const QVector<QImage>& images = sprites();
+    QImage atlas(cell_size.width()*PIECES, cell_size.height(), QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+
+    QPainter painter(&atlas);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    for(int i=0; i<PIECES; i++) {
+        if( images[i].isNull() ) {
+            continue;
+        }
+        // keep aspect ratio, center inside the cell
+        QSize scaled = images[i].size().scaled(cell_size, Qt::KeepAspectRatio);
+        QRect target(i*cell_size.width() + (cell_size.width() - scaled.width()) / 2,
+                     (cell_size.height() - scaled.height()) / 2, scaled.width(), scaled.height());
+        painter.drawImage(target, images[i]);
+    }
+    return atlas;
+}
+
+QRect PieceImageProvider::atlas_cell(int piece, const QSize& cell_size)
+{
+    return QRect(piece*cell_size.width(), 0, cell_size.width(), cell_size.height());
+}
+
+const QImage& PieceImageProvider::atlas(const QSize& cell_size)
+{
+    const QPair<int, int> key(cell_size.width(), cell_size.height());
+    auto iter = m_atlases.find(key);
+    if( iter == m_atlases.end() ) {
+        if( m_atlases.size() >= MAX_ATLASES ) {
+            m_atlases.clear();
+        }
+        iter = m_atlases.insert(key, render_atlas(cell_size));
+    }
+    return iter.value();
+}
+
+QImage PieceImageProvider::requestImage(const QString& id, QSize* size, const QSize& requested_size)
+{
+    bool ok = false;
+    int piece = id.toInt(&ok);
+    if( !ok || piece <= 0 || piece >= PIECES ) {
+        return QImage();
+    }
+
+    const QSize cell_size = (requested_size.width() > 0 && requested_size.height() > 0) ?
+                            requested_size : QSize(DEFAULT_CELL_SIZE, DEFAULT_CELL_SIZE);
+    if( size ) {
+        *size = cell_size;
+    }
+    QMutexLocker lock(&m_mutex);
+    // copy of a cell is a plain memcpy, QML caches the result per source & size
+    return atlas(cell_size).copy(atlas_cell(piece, cell_size));
+}
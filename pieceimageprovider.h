@@ -0,0 +1,40 @@
+#ifndef PIECEIMAGEPROVIDER_H
+#define PIECEIMAGEPROVIDER_H
+
+#include <QQuickImageProvider>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QRect>
+#include <QMap>
+#include <QPair>
+
+/*
+ *  Serves piece sprites as "image://pieces/<ChessPiece as int>".
+ *  Sprites are decoded once, then kept in atlases scaled to the requested cell sizes,
+ *  so a board update never touches png decoding or smooth scaling again. An atlas is kept
+ *  per size, views of different sizes (or device pixel ratios) don't re-render each other's.
+ */
+
+class PieceImageProvider : public QQuickImageProvider
+{
+public:
+    PieceImageProvider();
+
+    QImage requestImage(const QString& id, QSize* size, const QSize& requested_size);
+
+    //all pieces in one row, cell 0 (ChessPiece::NONE) is transparent
+    static QImage render_atlas(const QSize& cell_size);
+    static QRect atlas_cell(int piece, const QSize& cell_size);
+private:
+    //atlases kept before the cache starts over
+    static const int MAX_ATLASES = 8;
+
+    //renders the atlas on the first request of a size, must be called under m_mutex
+    const QImage& atlas(const QSize& cell_size);
+
+    QMap<QPair<int, int>, QImage> m_atlases;    //by cell width & height
+    QMutex m_mutex;                 //requests come from QML image loader threads
+};
+
+#endif // PIECEIMAGEPROVIDER_H
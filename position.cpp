@@ -0,0 +1,554 @@
+#include "position.h"
+#include "chessboard.h"
+#include "zobrist.h"
+
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+
+/*
+ *  Auxiliary functions
+ */
+
+inline bool is_white_piece(ChessPiece cp)
+{
+    return cp >= ChessPiece::WT_KING && cp <= ChessPiece::WT_PAWN;
+}
+
+inline bool is_black_piece(ChessPiece cp)
+{
+    return cp >= ChessPiece::BK_KING && cp <= ChessPiece::BK_PAWN;
+}
+
+inline int side_of(ChessPiece cp)
+{
+    return is_white_piece(cp) ? Position::WHITE : Position::BLACK;
+}
+
+//piece kind regardless of color: 0 king, 1 queen, 2 bishop, 3 knight, 4 castle, 5 pawn
+inline int kind_of(ChessPiece cp)
+{
+    return (to_int(cp) - 1) % 6;
+}
+
+enum { KING = 0, QUEEN, BISHOP, KNIGHT, CASTLE, PAWN };
+
+static const char FEN_PIECES[] = " KQBNRPkqbnrp";
+
+static const int PIECE_VALUES[6] = { 0, 900, 330, 320, 500, 100 };
+
+// piece-square bonuses for white, row 0 is the first rank
+static const int PST[6][64] = {
+    {   // king: stay behind pawns
+         20, 30, 10,  0,  0, 10, 30, 20,
+         20, 20,  0,  0,  0,  0, 20, 20,
+        -10,-20,-20,-20,-20,-20,-20,-10,
+        -20,-30,-30,-40,-40,-30,-30,-20,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30,
+        -30,-40,-40,-50,-50,-40,-40,-30 },
+    {   // queen
+        -20,-10,-10, -5, -5,-10,-10,-20,
+        -10,  0,  5,  0,  0,  0,  0,-10,
+        -10,  5,  5,  5,  5,  5,  0,-10,
+          0,  0,  5,  5,  5,  5,  0, -5,
+         -5,  0,  5,  5,  5,  5,  0, -5,
+        -10,  0,  5,  5,  5,  5,  0,-10,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -20,-10,-10, -5, -5,-10,-10,-20 },
+    {   // bishop
+        -20,-10,-10,-10,-10,-10,-10,-20,
+        -10,  5,  0,  0,  0,  0,  5,-10,
+        -10, 10, 10, 10, 10, 10, 10,-10,
+        -10,  0, 10, 10, 10, 10,  0,-10,
+        -10,  5,  5, 10, 10,  5,  5,-10,
+        -10,  0,  5, 10, 10,  5,  0,-10,
+        -10,  0,  0,  0,  0,  0,  0,-10,
+        -20,-10,-10,-10,-10,-10,-10,-20 },
+    {   // knight
+        -50,-40,-30,-30,-30,-30,-40,-50,
+        -40,-20,  0,  5,  5,  0,-20,-40,
+        -30,  5, 10, 15, 15, 10,  5,-30,
+        -30,  0, 15, 20, 20, 15,  0,-30,
+        -30,  5, 15, 20, 20, 15,  5,-30,
+        -30,  0, 10, 15, 15, 10,  0,-30,
+        -40,-20,  0,  0,  0,  0,-20,-40,
+        -50,-40,-30,-30,-30,-30,-40,-50 },
+    {   // castle
+          0,  0,  0,  5,  5,  0,  0,  0,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+         -5,  0,  0,  0,  0,  0,  0, -5,
+          5, 10, 10, 10, 10, 10, 10,  5,
+          0,  0,  0,  0,  0,  0,  0,  0 },
+    {   // pawn
+          0,  0,  0,  0,  0,  0,  0,  0,
+          5, 10, 10,-20,-20, 10, 10,  5,
+          5, -5,-10,  0,  0,-10, -5,  5,
+          0,  0,  0, 20, 20,  0,  0,  0,
+          5,  5, 10, 25, 25, 10,  5,  5,
+         10, 10, 20, 30, 30, 20, 10, 10,
+         50, 50, 50, 50, 50, 50, 50, 50,
+          0,  0,  0,  0,  0,  0,  0,  0 }
+};
+
+//white point of view
+inline int piece_score(ChessPiece cp, int sq)
+{
+    if( cp == ChessPiece::NONE ) {
+        return 0;
+    }
+    int kind = kind_of(cp);
+    if( is_white_piece(cp) ) {
+        return PIECE_VALUES[kind] + PST[kind][sq];
+    }
+    // mirror rows for black
+    return -(PIECE_VALUES[kind] + PST[kind][(7 - sq/8)*8 + sq%8]);
+}
+
+inline PackedMove make_packed(int src, int dst)
+{
+    return static_cast<PackedMove>(src*64 + dst);
+}
+
+static const int KNIGHT_STEPS[8][2] = { {1,2}, {2,1}, {2,-1}, {1,-2}, {-1,-2}, {-2,-1}, {-2,1}, {-1,2} };
+static const int KING_STEPS[8][2]   = { {1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1} };
+static const int BISHOP_DIRS[4][2]  = { {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+static const int CASTLE_DIRS[4][2]  = { {1,0}, {-1,0}, {0,1}, {0,-1} };
+
+/*
+ *  Position implementation
+ */
+
+Position::Position()
+{
+    clear();
+}
+
+void Position::clear()
+{
+    std::fill_n(m_squares, SQUARES, ChessPiece::NONE);
+    std::fill_n(m_1st_move, SQUARES, false);
+    std::fill_n(m_piece_counts, to_int(ChessPiece::PIECES_COUNT), 0);
+    m_piece_counts[to_int(ChessPiece::NONE)] = SQUARES;
+    m_side = WHITE;
+    m_halfmove_clock = 0;
+    m_hash = 0;
+    m_pawn_hash = 0;
+    m_eval = 0;
+}
+
+void Position::reset_hash()
+{
+    m_hash = (m_side == BLACK) ? Zobrist::black_to_move() : 0;
+    m_pawn_hash = 0;
+    m_eval = 0;
+    for(int sq=0; sq<SQUARES; sq++) {
+        m_hash ^= Zobrist::piece(to_int(m_squares[sq]), sq/8, sq%8);
+        if( is_pawn(m_squares[sq]) ) {
+            m_pawn_hash ^= Zobrist::piece(to_int(m_squares[sq]), sq/8, sq%8);
+        }
+        m_eval += piece_score(m_squares[sq], sq);
+        int ind = Zobrist::castling_square(sq/8, sq%8);
+        if( ind >= 0 && m_1st_move[sq] ) {
+            m_hash ^= Zobrist::castling(ind);
+        }
+    }
+}
+
+void Position::set_piece(int sq, ChessPiece cp)
+{
+    ChessPiece old = m_squares[sq];
+    m_hash ^= Zobrist::piece(to_int(old), sq/8, sq%8) ^ Zobrist::piece(to_int(cp), sq/8, sq%8);
+    if( is_pawn(old) ) {
+        m_pawn_hash ^= Zobrist::piece(to_int(old), sq/8, sq%8);
+    }
+    if( is_pawn(cp) ) {
+        m_pawn_hash ^= Zobrist::piece(to_int(cp), sq/8, sq%8);
+    }
+    m_eval += piece_score(cp, sq) - piece_score(old, sq);
+    m_piece_counts[to_int(old)]--;
+    m_piece_counts[to_int(cp)]++;
+    m_squares[sq] = cp;
+}
+
+void Position::set_1st_move(int sq, bool flag)
+{
+    int ind = Zobrist::castling_square(sq/8, sq%8);
+    if( ind >= 0 && m_1st_move[sq] != flag ) {
+        m_hash ^= Zobrist::castling(ind);
+    }
+    m_1st_move[sq] = flag;
+}
+
+bool Position::set_fen(const std::string& fen)
+{
+    clear();
+    std::istringstream in(fen);
+    std::string board, side, castling;
+    int halfmove = 0;
+    if( !(in >> board >> side) ) {
+        return false;
+    }
+    in >> castling;
+    std::string en_passant;
+    in >> en_passant;       //there is no en passant in our rules
+    if( !(in >> halfmove) ) {
+        halfmove = 0;
+    }
+
+    int r = 7, c = 0;
+    for(size_t i=0; i<board.size(); i++) {
+        char ch = board[i];
+        if( ch == '/' ) {
+            if( c != 8 || r == 0 ) {
+                return false;
+            }
+            r--;
+            c = 0;
+        } else if( ch >= '1' && ch <= '8' ) {
+            c += ch - '0';
+            if( c > 8 ) {
+                return false;
+            }
+        } else {
+            const char* p = std::find(FEN_PIECES+1, FEN_PIECES+sizeof(FEN_PIECES)-1, ch);
+            if( *p == 0 || c >= 8 ) {
+                return false;
+            }
+            m_squares[r*8 + c++] = static_cast<ChessPiece>(p - FEN_PIECES);
+        }
+    }
+    if( r != 0 || c != 8 || (side != "w" && side != "b") ) {
+        return false;
+    }
+    m_side = (side == "w") ? WHITE : BLACK;
+    m_halfmove_clock = std::max(0, halfmove);
+
+    // castling right = king & castle didn't move
+    struct Right { char ch; int king; int castle; ChessPiece king_cp; ChessPiece castle_cp; };
+    static const Right RIGHTS[] = {
+        { 'K', 4,  7,  ChessPiece::WT_KING, ChessPiece::WT_CASTLE },
+        { 'Q', 4,  0,  ChessPiece::WT_KING, ChessPiece::WT_CASTLE },
+        { 'k', 60, 63, ChessPiece::BK_KING, ChessPiece::BK_CASTLE },
+        { 'q', 60, 56, ChessPiece::BK_KING, ChessPiece::BK_CASTLE }
+    };
+    for(size_t i=0; i<sizeof(RIGHTS)/sizeof(RIGHTS[0]); i++) {
+        const Right& right = RIGHTS[i];
+        if( castling.find(right.ch) != std::string::npos &&
+            m_squares[right.king] == right.king_cp && m_squares[right.castle] == right.castle_cp )
+        {
+            m_1st_move[right.king] = m_1st_move[right.castle] = true;
+        }
+    }
+
+    std::fill_n(m_piece_counts, to_int(ChessPiece::PIECES_COUNT), 0);
+    for(int sq=0; sq<SQUARES; sq++) {
+        m_piece_counts[to_int(m_squares[sq])]++;
+    }
+    reset_hash();
+    return true;
+}
+
+std::string Position::get_fen() const
+{
+    std::ostringstream out;
+    for(int r=7; r>=0; r--) {
+        int empty = 0;
+        for(int c=0; c<8; c++) {
+            ChessPiece cp = m_squares[r*8+c];
+            if( cp == ChessPiece::NONE ) {
+                empty++;
+                continue;
+            }
+            if( empty ) {
+                out << empty;
+                empty = 0;
+            }
+            out << FEN_PIECES[to_int(cp)];
+        }
+        if( empty ) {
+            out << empty;
+        }
+        if( r ) {
+            out << '/';
+        }
+    }
+    out << (m_side == WHITE ? " w " : " b ");
+
+    std::string castling;
+    const bool wt_king = m_squares[4] == ChessPiece::WT_KING && m_1st_move[4];
+    const bool bk_king = m_squares[60] == ChessPiece::BK_KING && m_1st_move[60];
+    if( wt_king && m_squares[7] == ChessPiece::WT_CASTLE && m_1st_move[7] )      castling += 'K';
+    if( wt_king && m_squares[0] == ChessPiece::WT_CASTLE && m_1st_move[0] )      castling += 'Q';
+    if( bk_king && m_squares[63] == ChessPiece::BK_CASTLE && m_1st_move[63] )    castling += 'k';
+    if( bk_king && m_squares[56] == ChessPiece::BK_CASTLE && m_1st_move[56] )    castling += 'q';
+    out << (castling.empty() ? "-" : castling) << " - " << m_halfmove_clock << " 1";
+    return out.str();
+}
+
+void Position::set_board(const ChessBoard& board)
+{
+    clear();
+    std::fill_n(m_piece_counts, to_int(ChessPiece::PIECES_COUNT), 0);
+    for(int sq=0; sq<SQUARES; sq++) {
+        m_squares[sq] = board.get_board_piece(sq/8, sq%8);
+        m_1st_move[sq] = board.is_1st_move(sq/8, sq%8);
+        m_piece_counts[to_int(m_squares[sq])]++;
+    }
+    m_side = board.get_current_side();
+    m_halfmove_clock = board.get_halfmove_clock();
+    reset_hash();
+}
+
+bool Position::has_king(int side) const
+{
+    return m_piece_counts[to_int(side == WHITE ? ChessPiece::WT_KING : ChessPiece::BK_KING)] > 0;
+}
+
+int Position::king_square(int side) const
+{
+    const ChessPiece king = (side == WHITE) ? ChessPiece::WT_KING : ChessPiece::BK_KING;
+    if( m_piece_counts[to_int(king)] == 0 ) {
+        return -1;
+    }
+    return static_cast<int>(std::find(m_squares, m_squares + SQUARES, king) - m_squares);
+}
+
+uint64_t Position::perft(int depth) const
+{
+    if( depth == 0 ) {
+        return 1;
+    }
+    if( !has_king(m_side) ) {
+        return 0;
+    }
+    PackedMove moves[MAX_MOVES];
+    const int count = generate_moves(moves);
+    if( depth == 1 ) {
+        return count;
+    }
+    uint64_t res = 0;
+    for(int i=0; i<count; i++) {
+        Position next(*this);
+        next.make_move(moves[i]);
+        res += next.perft(depth - 1);
+    }
+    return res;
+}
+
+int Position::evaluate() const
+{
+    return (m_side == WHITE) ? m_eval : -m_eval;
+}
+
+bool Position::is_castling(PackedMove move) const
+{
+    ChessPiece src = m_squares[move >> 6];
+    ChessPiece dst = m_squares[move & 63];
+    return (src == ChessPiece::WT_KING && dst == ChessPiece::WT_CASTLE) ||
+           (src == ChessPiece::BK_KING && dst == ChessPiece::BK_CASTLE);
+}
+
+int Position::generate_moves(PackedMove* moves) const
+{
+    return generate<false>(moves);
+}
+
+int Position::generate_captures(PackedMove* moves) const
+{
+    return generate<true>(moves);
+}
+
+template<bool CAPTURES_ONLY>
+int Position::generate(PackedMove* moves) const
+{
+    int count = 0;
+    const bool white = (m_side == WHITE);
+
+    // 0 - empty, 1 - enemy, 2 - own piece
+    auto target = [this, white](int sq) {
+        ChessPiece cp = m_squares[sq];
+        if( cp == ChessPiece::NONE ) {
+            return 0;
+        }
+        return (is_white_piece(cp) == white) ? 2 : 1;
+    };
+    auto add = [&](int src, int dst) {
+        moves[count++] = make_packed(src, dst);
+    };
+
+    for(int src=0; src<SQUARES; src++) {
+        ChessPiece cp = m_squares[src];
+        if( cp == ChessPiece::NONE || is_white_piece(cp) != white ) {
+            continue;
+        }
+        const int r = src/8, c = src%8;
+        switch( kind_of(cp) ) {
+            case PAWN: {
+                const int dir = white ? 1 : -1;
+                const int next = r + dir;
+                if( next < 0 || next > 7 ) {
+                    break;
+                }
+                for(int dc=-1; dc<=1; dc+=2) {
+                    if( c+dc >= 0 && c+dc < 8 && target(next*8 + c+dc) == 1 ) {
+                        add(src, next*8 + c+dc);
+                    }
+                }
+                if( m_squares[next*8 + c] == ChessPiece::NONE ) {
+                    const bool promotion = (next == 0 || next == 7);
+                    if( !CAPTURES_ONLY || promotion ) {
+                        add(src, next*8 + c);
+                    }
+                    const int start = white ? 1 : 6;
+                    if( !CAPTURES_ONLY && r == start && m_squares[(r + 2*dir)*8 + c] == ChessPiece::NONE ) {
+                        add(src, (r + 2*dir)*8 + c);
+                    }
+                }
+                break;
+            }
+            case KNIGHT: case KING: {
+                const int (*steps)[2] = (kind_of(cp) == KNIGHT) ? KNIGHT_STEPS : KING_STEPS;
+                for(int i=0; i<8; i++) {
+                    int tr = r + steps[i][0], tc = c + steps[i][1];
+                    if( tr < 0 || tr > 7 || tc < 0 || tc > 7 ) {
+                        continue;
+                    }
+                    int t = target(tr*8 + tc);
+                    if( t == 1 || (t == 0 && !CAPTURES_ONLY) ) {
+                        add(src, tr*8 + tc);
+                    }
+                }
+                // castling, see Castling::apply
+                const int row = white ? 0 : 7;
+                const ChessPiece castle = white ? ChessPiece::WT_CASTLE : ChessPiece::BK_CASTLE;
+                if( CAPTURES_ONLY || kind_of(cp) != KING || r != row || !m_1st_move[src] ) {
+                    break;
+                }
+                for(int dst_c=0; dst_c<8; dst_c+=7) {
+                    const int dst = row*8 + dst_c;
+                    const int inc = (dst_c > c) ? 1 : -1;
+                    if( m_squares[dst] != castle || !m_1st_move[dst] || std::abs(dst_c - c) <= 1 ||
+                        c + 2*inc < 0 || c + 2*inc > 7 )
+                    {
+                        continue;
+                    }
+                    bool empty = true;
+                    for(int i=c+inc; i!=dst_c && empty; i+=inc) {
+                        empty = m_squares[row*8 + i] == ChessPiece::NONE;
+                    }
+                    if( empty ) {
+                        add(src, dst);
+                    }
+                }
+                break;
+            }
+            default: {
+                const int kind = kind_of(cp);
+                for(int d=0; d<8; d++) {
+                    const int* dir;
+                    if( d < 4 ) {
+                        if( kind == BISHOP ) {
+                            continue;
+                        }
+                        dir = CASTLE_DIRS[d];
+                    } else {
+                        if( kind == CASTLE ) {
+                            continue;
+                        }
+                        dir = BISHOP_DIRS[d-4];
+                    }
+                    for(int tr=r+dir[0], tc=c+dir[1]; tr>=0 && tr<8 && tc>=0 && tc<8; tr+=dir[0], tc+=dir[1]) {
+                        int t = target(tr*8 + tc);
+                        if( t == 2 ) {
+                            break;
+                        }
+                        if( t == 1 || !CAPTURES_ONLY ) {
+                            add(src, tr*8 + tc);
+                        }
+                        if( t == 1 ) {
+                            break;
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+bool Position::is_legal(PackedMove move) const
+{
+    if( move == NO_MOVE ) {
+        return false;
+    }
+    ChessPiece cp = m_squares[move >> 6];
+    if( cp == ChessPiece::NONE || side_of(cp) != m_side ) {
+        return false;
+    }
+    PackedMove moves[MAX_MOVES];
+    int count = generate_moves(moves);
+    return std::find(moves, moves + count, move) != moves + count;
+}
+
+void Position::make_move(PackedMove move)
+{
+    const int src = move >> 6, dst = move & 63;
+    const ChessPiece piece = m_squares[src];
+    const ChessPiece captured = m_squares[dst];
+
+    if( is_castling(move) ) {
+        const int inc = (dst > src) ? 1 : -1;
+        set_piece(src, ChessPiece::NONE);
+        set_piece(dst, ChessPiece::NONE);
+        set_piece(src + 2*inc, piece);
+        set_piece(src + inc, captured);
+        set_1st_move(src, false);
+        set_1st_move(dst, false);
+        set_1st_move(src + 2*inc, false);
+        set_1st_move(src + inc, false);
+        m_halfmove_clock++;
+    } else {
+        ChessPiece moved = piece;
+        if( piece == ChessPiece::WT_PAWN && dst/8 == 7 ) {
+            moved = ChessPiece::WT_QUEEN;
+        } else if( piece == ChessPiece::BK_PAWN && dst/8 == 0 ) {
+            moved = ChessPiece::BK_QUEEN;
+        }
+        set_piece(dst, moved);
+        set_piece(src, ChessPiece::NONE);
+        set_1st_move(src, false);
+        set_1st_move(dst, false);
+
+        bool irreversible = kind_of(piece) == PAWN || captured != ChessPiece::NONE;
+        m_halfmove_clock = irreversible ? 0 : m_halfmove_clock+1;
+    }
+
+    m_side = 1 - m_side;
+    m_hash ^= Zobrist::black_to_move();
+}
+
+void Position::make_null_move()
+{
+    m_side = 1 - m_side;
+    m_hash ^= Zobrist::black_to_move();
+    m_halfmove_clock++;
+}
+
+bool Position::can_take_king() const
+{
+    const ChessPiece king = (m_side == WHITE) ? ChessPiece::BK_KING : ChessPiece::WT_KING;
+    PackedMove moves[MAX_MOVES];
+    const int count = generate_captures(moves);
+    for(int i=0; i<count; i++) {
+        if( m_squares[moves[i] & 63] == king ) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,86 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include <string>
+#include <cstdint>
+
+#include "chesspiecemove.h"
+
+class ChessBoard;
+
+/*
+ *  Position - compact copy-make board for the engine.
+ *
+ *  Follows ChessBoard rules: no check detection (a game is lost by losing the king),
+ *  no en passant, pawns promote to queen, castling is king onto own rook with
+ *  "first move" flags on both squares. Hash is equal to ChessBoard::get_hash().
+ *  Square index is row*8+column like in PackedMove.
+ */
+
+class Position
+{
+public:
+    static const int SQUARES = 64;
+    static const int MAX_MOVES = 256;
+    static const int BLACK = 0;
+    static const int WHITE = 1;
+
+    Position();
+
+    //"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", castling rights become first move flags
+    bool set_fen(const std::string& fen);
+    std::string get_fen() const;
+    void set_board(const ChessBoard& board);
+
+    ChessPiece get(int sq) const                    {   return m_squares[sq];   }
+    bool is_1st_move(int sq) const                  {   return m_1st_move[sq];   }
+    int get_side() const                            {   return m_side;   }
+    int get_halfmove_clock() const                  {   return m_halfmove_clock;   }
+    uint64_t get_hash() const                       {   return m_hash;   }
+    //pawns only, side to move & castling flags are not included
+    uint64_t get_pawn_hash() const                  {   return m_pawn_hash;   }
+    int get_piece_count(ChessPiece cp) const        {   return m_piece_counts[to_int(cp)];   }
+    bool has_king(int side) const;
+    //@ret square of the king or -1
+    int king_square(int side) const;
+
+    //material & piece-square score from side to move point of view, in centipawns
+    int evaluate() const;
+
+    //all moves ChessBoard::make_move would accept, @ret moves count
+    int generate_moves(PackedMove* moves) const;
+    //captures & promotions only
+    int generate_captures(PackedMove* moves) const;
+    bool is_capture(PackedMove move) const          {   return m_squares[move & 63] != ChessPiece::NONE && !is_castling(move);   }
+    bool is_castling(PackedMove move) const;
+    bool is_legal(PackedMove move) const;
+
+    //move must be legal
+    void make_move(PackedMove move);
+    //passes the turn, only to look at threats of the side that just moved
+    void make_null_move();
+    //side to move can take the opponent king
+    bool can_take_king() const;
+
+    //leaf positions depth plies ahead, a line ends when a king is taken
+    uint64_t perft(int depth) const;
+private:
+    template<bool CAPTURES_ONLY>
+    int generate(PackedMove* moves) const;
+
+    void clear();
+    void set_piece(int sq, ChessPiece cp);
+    void set_1st_move(int sq, bool flag);
+    void reset_hash();
+
+    ChessPiece m_squares[SQUARES];
+    bool m_1st_move[SQUARES];
+    int m_side;
+    int m_halfmove_clock;
+    uint64_t m_hash;
+    uint64_t m_pawn_hash;
+    int m_eval;                     //white point of view
+    int m_piece_counts[static_cast<int>(ChessPiece::PIECES_COUNT)];
+};
+
+#endif // POSITION_H
@@ -0,0 +1,338 @@
+#include "positionindex.h"
+#include "chessboard.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <queue>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using std::make_shared;
+
+/*
+ *  Auxiliary functions
+ */
+
+static const char INDEX_MAGIC[8] = {'C','H','E','S','S','I','D','X'};
+static const uint32_t INDEX_VERSION = 1;
+
+inline bool entry_less(const PositionIndexEntry& e1, const PositionIndexEntry& e2)
+{
+    if( e1.hash != e2.hash ) {
+        return e1.hash < e2.hash;
+    }
+    if( e1.game != e2.game ) {
+        return e1.game < e2.game;
+    }
+    return e1.ply < e2.ply;
+}
+
+static bool file_exists(const string& file)
+{
+    std::ifstream in(file.c_str());
+    return in.good();
+}
+
+//replays main lines of games [first, last) of lines, game ids start from first_game + first
+static void index_games(const vector<string>& lines, size_t first, size_t last, uint32_t first_game,
+                        vector<PositionIndexEntry>& out)
+{
+    ChessBoard board;
+    for(size_t i=first; i<last; i++) {
+        // malformed tail of a game is ignored, loaded part is indexed
+        std::istringstream in(lines[i]);
+        board.load_game(in);
+        while( board.undo() ) {}
+
+        PositionIndexEntry entry;
+        entry.game = first_game + static_cast<uint32_t>(i);
+        entry.ply = 0;
+        while( true ) {
+            entry.hash = board.get_hash();
+            auto move = board.redo();
+            if( !move ) {
+                break;
+            }
+            entry.next_move = pack_move(move->get_src_pos(), move->get_dst_pos());
+            out.push_back(entry);
+            if( entry.ply == UINT16_MAX ) {
+                break;
+            }
+            entry.ply++;
+        }
+        entry.next_move = NO_MOVE;
+        out.push_back(entry);
+    }
+    std::sort(out.begin(), out.end(), entry_less);
+}
+
+/*
+ *  PositionIndex implementation
+ */
+
+struct PositionIndex::Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t block_entries;
+    uint64_t entries;
+    uint64_t blocks;
+    uint32_t first_game;
+    uint32_t games;
+};
+
+struct PositionIndex::Run
+{
+    MappedFile file;
+    const Header* header;
+    const uint64_t* sparse;
+    const PositionIndexEntry* entries;
+};
+
+PositionIndex::PositionIndex()
+{}
+
+string PositionIndex::run_path(const string& path, int n)
+{
+    if( n == 0 ) {
+        return path;
+    }
+    std::ostringstream out;
+    out << path << "." << n;
+    return out.str();
+}
+
+bool PositionIndex::open(const string& path)
+{
+    close();
+    for(int n=0; ; n++) {
+        string file = run_path(path, n);
+        auto run = make_shared<Run>();
+        if( !run->file.open(file) ) {
+            break;
+        }
+        const char* data = run->file.data();
+        const Header* header = reinterpret_cast<const Header*>(data);
+        if( run->file.size() < sizeof(Header) || memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+            header->version != INDEX_VERSION ||
+            run->file.size() != sizeof(Header) + header->blocks*sizeof(uint64_t) +
+                                header->entries*sizeof(PositionIndexEntry) )
+        {
+            close();
+            return false;
+        }
+        run->header = header;
+        run->sparse = reinterpret_cast<const uint64_t*>(data + sizeof(Header));
+        run->entries = reinterpret_cast<const PositionIndexEntry*>(run->sparse + header->blocks);
+        m_runs.push_back(run);
+    }
+    return !m_runs.empty();
+}
+
+void PositionIndex::close()
+{
+    m_runs.clear();
+}
+
+uint32_t PositionIndex::games_count() const
+{
+    uint32_t games = 0;
+    for(auto iter=m_runs.begin(); iter!=m_runs.end(); iter++) {
+        games = std::max(games, (*iter)->header->first_game + (*iter)->header->games);
+    }
+    return games;
+}
+
+PositionStats PositionIndex::query(uint64_t hash) const
+{
+    PositionStats stats;
+    stats.occurrences = 0;
+    stats.games = 0;
+
+    for(auto iter=m_runs.begin(); iter!=m_runs.end(); iter++) {
+        const Run& run = **iter;
+        const uint64_t blocks = run.header->blocks;
+        const uint64_t block_entries = run.header->block_entries;
+
+        // entries with the hash can start in the block preceding the first block beginning with it
+        uint64_t lo = std::lower_bound(run.sparse, run.sparse + blocks, hash) - run.sparse;
+        uint64_t hi = std::upper_bound(run.sparse, run.sparse + blocks, hash) - run.sparse;
+        lo = (lo > 0) ? lo-1 : 0;
+
+        const PositionIndexEntry* beg = run.entries + lo*block_entries;
+        const PositionIndexEntry* end = run.entries + std::min(hi*block_entries, run.header->entries);
+
+        PositionIndexEntry key;
+        key.hash = hash;
+        key.game = 0;
+        key.ply = 0;
+        const PositionIndexEntry* entry = std::lower_bound(beg, end, key, entry_less);
+
+        uint32_t last_game = UINT32_MAX;
+        for(; entry != end && entry->hash == hash; entry++) {
+            stats.occurrences++;
+            if( entry->game != last_game ) {
+                stats.games++;
+                last_game = entry->game;
+            }
+            if( entry->next_move == NO_MOVE ) {
+                continue;
+            }
+            auto move = stats.moves.begin();
+            while( move != stats.moves.end() && move->move != entry->next_move ) {
+                move++;
+            }
+            if( move == stats.moves.end() ) {
+                PositionMoveStat stat = { entry->next_move, 0 };
+                move = stats.moves.insert(move, stat);
+            }
+            move->count++;
+        }
+    }
+
+    std::sort(stats.moves.begin(), stats.moves.end(),
+              [](const PositionMoveStat& m1, const PositionMoveStat& m2) { return m1.count > m2.count; });
+    return stats;
+}
+
+bool PositionIndex::write_run(const string& file, vector<vector<PositionIndexEntry> >& parts,
+                              uint32_t first_game, uint32_t games)
+{
+    Header header;
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.block_entries = BLOCK_ENTRIES;
+    header.entries = 0;
+    for(auto iter=parts.begin(); iter!=parts.end(); iter++) {
+        header.entries += iter->size();
+    }
+    header.blocks = (header.entries + BLOCK_ENTRIES - 1) / BLOCK_ENTRIES;
+    header.first_game = first_game;
+    header.games = games;
+
+    // run appears under its name only when complete, a crash leaves just the temp file
+    const string tmp_file = file + ".tmp";
+    std::ofstream out(tmp_file.c_str(), std::ios::binary | std::ios::trunc);
+    if( !out ) {
+        return false;
+    }
+    vector<uint64_t> sparse(header.blocks);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sparse.data()), sparse.size()*sizeof(uint64_t));
+
+    // k-way merge of sorted parts
+    typedef std::pair<size_t, size_t> Cursor;   //part, position
+    auto greater = [&parts](const Cursor& c1, const Cursor& c2) {
+        return entry_less(parts[c2.first][c2.second], parts[c1.first][c1.second]);
+    };
+    std::priority_queue<Cursor, vector<Cursor>, decltype(greater)> heap(greater);
+    for(size_t i=0; i<parts.size(); i++) {
+        if( !parts[i].empty() ) {
+            heap.push(Cursor(i, 0));
+        }
+    }
+
+    vector<PositionIndexEntry> block;
+    block.reserve(BLOCK_ENTRIES);
+    uint64_t block_num = 0;
+    while( !heap.empty() ) {
+        Cursor top = heap.top();
+        heap.pop();
+        block.push_back(parts[top.first][top.second]);
+        if( ++top.second < parts[top.first].size() ) {
+            heap.push(top);
+        }
+        if( block.size() == BLOCK_ENTRIES || heap.empty() ) {
+            sparse[block_num++] = block.front().hash;
+            out.write(reinterpret_cast<const char*>(block.data()), block.size()*sizeof(PositionIndexEntry));
+            block.clear();
+        }
+    }
+    parts.clear();
+
+    out.seekp(sizeof(header));
+    out.write(reinterpret_cast<const char*>(sparse.data()), sparse.size()*sizeof(uint64_t));
+    out.close();
+
+    bool ok = !out.fail();
+    int fd = ok ? ::open(tmp_file.c_str(), O_WRONLY) : -1;
+    ok = fd >= 0 && fsync(fd) == 0;
+    if( fd >= 0 ) {
+        ::close(fd);
+    }
+    if( !ok || std::rename(tmp_file.c_str(), file.c_str()) != 0 ) {
+        std::remove(tmp_file.c_str());
+        return false;
+    }
+    return sync_parent_dir(file);
+}
+
+bool PositionIndex::build(const string& games_file, const string& path, int threads)
+{
+    for(int n=0; file_exists(run_path(path, n)); n++) {
+        std::remove(run_path(path, n).c_str());
+    }
+    return append(games_file, path, threads);
+}
+
+bool PositionIndex::append(const string& games_file, const string& path, int threads)
+{
+    std::ifstream in(games_file.c_str());
+    if( !in ) {
+        return false;
+    }
+    threads = std::max(threads, 1);
+
+    int run = 0;
+    uint32_t first_game = 0;
+    {
+        PositionIndex existing;
+        if( existing.open(path) ) {
+            run = static_cast<int>(existing.m_runs.size());
+            first_game = existing.games_count();
+        } else if( file_exists(path) ) {
+            //don't overwrite something that isn't an index
+            return false;
+        }
+    }
+
+    bool ok = true;
+    while( ok && in ) {
+        // read a batch of games which fits into MAX_RUN_ENTRIES (every move takes ~8 chars)
+        vector<string> lines;
+        size_t chars = 0;
+        string line;
+        while( chars/8 < MAX_RUN_ENTRIES && std::getline(in, line) ) {
+            chars += line.size() + 8;
+            lines.push_back(line);
+        }
+        if( lines.empty() ) {
+            break;
+        }
+
+        vector<vector<PositionIndexEntry> > parts(threads);
+        vector<std::thread> workers;
+        const size_t chunk = (lines.size() + threads - 1) / threads;
+        for(int t=0; t<threads; t++) {
+            size_t first = std::min(lines.size(), t*chunk);
+            size_t last = std::min(lines.size(), first+chunk);
+            workers.push_back(std::thread(index_games, std::cref(lines), first, last, first_game,
+                                          std::ref(parts[t])));
+        }
+        for(auto iter=workers.begin(); iter!=workers.end(); iter++) {
+            iter->join();
+        }
+
+        ok = write_run(run_path(path, run++), parts, first_game, static_cast<uint32_t>(lines.size()));
+        first_game += static_cast<uint32_t>(lines.size());
+    }
+    return ok;
+}
@@ -0,0 +1,79 @@
+#ifndef POSITIONINDEX_H
+#define POSITIONINDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "chesspiecemove.h"
+#include "mappedfile.h"
+
+/*
+ *  PositionIndex - on-disk index: position hash -> (game id, ply, next move)
+ *
+ *  Games file contains one game per line in ChessBoard::save_game format,
+ *  game id is a line number counted over all appended files.
+ *
+ *  Index consists of runs: "<path>", "<path>.1", "<path>.2", ...
+ *  Every run is a file with entries sorted by hash and split into blocks;
+ *  the first hash of every block is kept in a sparse index right after the header.
+ *  Append writes new runs and never touches the existing ones, a run is renamed into
+ *  place once it is complete & synced so a crash never leaves a truncated one.
+ */
+
+struct PositionIndexEntry
+{
+    uint64_t hash;
+    uint32_t game;
+    uint16_t ply;
+    PackedMove next_move;       //NO_MOVE if game ends in this position
+};
+
+struct PositionMoveStat
+{
+    PackedMove move;
+    uint64_t count;
+};
+
+struct PositionStats
+{
+    uint64_t occurrences;
+    uint32_t games;
+    //sorted by count, most popular first
+    std::vector<PositionMoveStat> moves;
+};
+
+class PositionIndex
+{
+public:
+    static const uint32_t BLOCK_ENTRIES = 256;
+    //entries kept in memory while building, bigger inputs are split into several runs
+    static const size_t MAX_RUN_ENTRIES = 1 << 24;
+
+    PositionIndex();
+
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const                        {   return !m_runs.empty();  }
+
+    PositionStats query(uint64_t hash) const;
+    uint32_t games_count() const;
+
+    //creates index from scratch, removing existing runs
+    static bool build(const std::string& games_file, const std::string& path, int threads);
+    //indexes games_file as new runs; ids continue after already indexed games
+    static bool append(const std::string& games_file, const std::string& path, int threads);
+
+private:
+    struct Header;
+    struct Run;
+
+    static std::string run_path(const std::string& path, int n);
+    static bool write_run(const std::string& file, std::vector<std::vector<PositionIndexEntry> >& parts,
+                          uint32_t first_game, uint32_t games);
+
+    std::vector<std::shared_ptr<Run> > m_runs;
+};
+
+#endif // POSITIONINDEX_H
@@ -0,0 +1,158 @@
+#include "preanalyzer.h"
+
+/*
+ *  PreAnalyzer implementation
+ */
+
+const int PreAnalyzer::PREVIEW_DEPTH;
+const size_t PreAnalyzer::MAX_RESULTS;
+
+PreAnalyzer::PreAnalyzer(size_t hash_mb, const ResultCallback& callback):
+    m_tt(hash_mb), m_searcher(m_tt), m_callback(callback), m_quit(false), m_active(false),
+    m_multi_pv(1), m_running(0), m_interrupted(false)
+{
+    m_thread = std::thread(&PreAnalyzer::run, this);
+}
+
+PreAnalyzer::~PreAnalyzer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        interrupt();
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void PreAnalyzer::set_positions(const Position& current, const std::vector<Position>& upcoming, int multi_pv)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if( multi_pv != m_multi_pv ) {
+            m_results.clear();
+            m_multi_pv = multi_pv;
+            interrupt();
+        }
+        // the current position goes first, a preview or the previous one waits
+        if( m_running != current.get_hash() ) {
+            interrupt();
+        }
+        m_current = current;
+        m_upcoming = upcoming;
+        m_active = true;
+        m_tt.new_search();
+    }
+    m_wake.notify_one();
+}
+
+void PreAnalyzer::stop()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active = false;
+    interrupt();
+}
+
+bool PreAnalyzer::lookup(uint64_t hash, SearchResult& result) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_results.find(hash);
+    if( iter == m_results.end() || iter->second.result.depth == 0 ) {
+        return false;
+    }
+    result = iter->second.result;
+    return true;
+}
+
+void PreAnalyzer::interrupt()
+{
+    if( m_running ) {
+        m_interrupted = true;
+        m_searcher.stop();
+    }
+}
+
+int PreAnalyzer::known_depth(uint64_t hash) const
+{
+    auto iter = m_results.find(hash);
+    return (iter == m_results.end()) ? 0 : iter->second.result.depth;
+}
+
+bool PreAnalyzer::next_task(Position& pos, int& depth)
+{
+    if( !m_active ) {
+        return false;
+    }
+    // previews first, then as deep as it goes for the current position
+    std::vector<std::pair<const Position*, int> > tasks;
+    tasks.push_back(std::make_pair(&m_current, static_cast<int>(PREVIEW_DEPTH)));
+    for(auto iter=m_upcoming.begin(); iter!=m_upcoming.end(); iter++) {
+        tasks.push_back(std::make_pair(&*iter, static_cast<int>(PREVIEW_DEPTH)));
+    }
+    tasks.push_back(std::make_pair(&m_current, MAX_PLY - 1));
+
+    for(auto iter=tasks.begin(); iter!=tasks.end(); iter++) {
+        auto entry = m_results.find(iter->first->get_hash());
+        if( entry != m_results.end() && (entry->second.complete || entry->second.result.depth >= iter->second) ) {
+            continue;
+        }
+        pos = *iter->first;
+        depth = iter->second;
+        return true;
+    }
+    return false;
+}
+
+void PreAnalyzer::publish(const Position& pos, const SearchResult& result)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if( m_interrupted ) {
+            return;
+        }
+        if( m_results.size() >= MAX_RESULTS && m_results.find(pos.get_hash()) == m_results.end() ) {
+            m_results.clear();
+        }
+        Entry& entry = m_results[pos.get_hash()];
+        if( result.depth <= entry.result.depth ) {
+            return;
+        }
+        entry.result = result;
+    }
+    if( m_callback ) {
+        m_callback(pos, result);
+    }
+}
+
+void PreAnalyzer::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while( !m_quit ) {
+        Position pos;
+        int depth;
+        if( !next_task(pos, depth) ) {
+            m_wake.wait(lock);
+            continue;
+        }
+        const uint64_t hash = pos.get_hash();
+        SearchLimits limits;
+        limits.depth = depth;
+        limits.start_depth = known_depth(hash) + 1;
+        limits.multi_pv = m_multi_pv;
+        m_running = hash;
+        m_interrupted = false;
+        m_searcher.resume();
+        lock.unlock();
+
+        SearchResult result = m_searcher.search(pos, limits, [this, &pos](const SearchResult& iteration) {
+            publish(pos, iteration);
+        });
+
+        lock.lock();
+        m_running = 0;
+        // ended before the limit: mates found or no moves at all
+        if( !m_interrupted && (result.depth < depth || depth == MAX_PLY - 1) ) {
+            m_results[hash].complete = true;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef PREANALYZER_H
+#define PREANALYZER_H
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "search.h"
+
+/*
+ *  PreAnalyzer - background analysis of the current position & the ones coming after it,
+ *  for stepping through a game with undo/redo.
+ *
+ *  One worker thread: the current position is searched to PREVIEW_DEPTH, then every upcoming
+ *  position in order, then the current one is deepened for as long as it stays current.
+ *  Results are kept by position hash. A position that becomes current is never searched from
+ *  scratch again: the search resumes at the iteration after the deepest one it has, the table
+ *  holds the shallower ones.
+ */
+
+class PreAnalyzer
+{
+public:
+    static const int PREVIEW_DEPTH = 6;
+    //results of older positions are dropped at once when there are more of them
+    static const size_t MAX_RESULTS = 4096;
+
+    //called from the worker thread after every completed iteration of any position
+    typedef std::function<void(const Position& pos, const SearchResult& result)> ResultCallback;
+
+    PreAnalyzer(size_t hash_mb, const ResultCallback& callback);
+    ~PreAnalyzer();
+
+    //current - gets the first & the deepest search, upcoming - positions likely to become current, nearest first
+    //a search of a position which is still wanted goes on, results are dropped when multi_pv changes
+    void set_positions(const Position& current, const std::vector<Position>& upcoming, int multi_pv);
+    //worker idles, results are kept
+    void stop();
+
+    //deepest result of a position so far
+    bool lookup(uint64_t hash, SearchResult& result) const;
+private:
+    PreAnalyzer(const PreAnalyzer&);
+    PreAnalyzer& operator=(const PreAnalyzer&);
+
+    struct Entry
+    {
+        Entry():
+            complete(false)
+        {}
+        SearchResult result;
+        bool complete;                  //nothing to deepen: max depth or all lines are mates
+    };
+
+    void run();
+    //next position to search & its depth limit, under m_mutex
+    bool next_task(Position& pos, int& depth);
+    int known_depth(uint64_t hash) const;
+    //stops the running search, its later results are dropped
+    void interrupt();
+    void publish(const Position& pos, const SearchResult& result);
+
+    TranspositionTable m_tt;
+    Searcher m_searcher;
+    ResultCallback m_callback;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit;
+    bool m_active;
+    Position m_current;
+    std::vector<Position> m_upcoming;
+    int m_multi_pv;
+    uint64_t m_running;                 //hash of the position being searched, 0 if idle
+    bool m_interrupted;
+    std::unordered_map<uint64_t, Entry> m_results;
+
+    std::thread m_thread;
+};
+
+#endif // PREANALYZER_H
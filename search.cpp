@@ -0,0 +1,378 @@
+#include "search.h"
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <cstring>
+
+/*
+ *  Auxiliary functions
+ */
+
+static const int INFINITE_SCORE = MATE_SCORE + 1;
+static const int DRAW_SCORE = 0;
+static const int FIFTY_MOVES_PLIES = 100;
+//nodes between budget checks
+static const uint64_t CHECK_INTERVAL = 1024;
+
+static const int PIECE_ORDER_VALUES[static_cast<int>(ChessPiece::PIECES_COUNT)] = {
+    0, 20000, 900, 330, 320, 500, 100,
+       20000, 900, 330, 320, 500, 100
+};
+
+//mate scores are stored relative to the node, not to the root
+inline int score_to_tt(int score, int ply)
+{
+    if( score > MATE_BOUND ) {
+        return score + ply;
+    }
+    if( score < -MATE_BOUND ) {
+        return score - ply;
+    }
+    return score;
+}
+
+inline int score_from_tt(int score, int ply)
+{
+    if( score > MATE_BOUND ) {
+        return score - ply;
+    }
+    if( score < -MATE_BOUND ) {
+        return score + ply;
+    }
+    return score;
+}
+
+//picks the best scored move of [from, count) & moves it to from
+inline void pick_move(PackedMove* moves, int* scores, int from, int count)
+{
+    int best = from;
+    for(int i=from+1; i<count; i++) {
+        if( scores[i] > scores[best] ) {
+            best = i;
+        }
+    }
+    std::swap(moves[from], moves[best]);
+    std::swap(scores[from], scores[best]);
+}
+
+/*
+ *  TranspositionTable implementation
+ *  data: move 16 | score 16 | depth 8 | bound 8 | generation 8
+ */
+
+TranspositionTable::TranspositionTable(size_t megabytes):
+    m_size(1), m_generation(0)
+{
+    const size_t bytes = std::max<size_t>(megabytes, 1) << 20;
+    while( m_size*2*sizeof(Slot) <= bytes ) {
+        m_size *= 2;
+    }
+    m_mask = m_size - 1;
+    m_slots.reset(new Slot[m_size]);
+    clear();
+}
+
+void TranspositionTable::clear()
+{
+    for(size_t i=0; i<m_size; i++) {
+        m_slots[i].key.store(0, std::memory_order_relaxed);
+        m_slots[i].data.store(0, std::memory_order_relaxed);
+    }
+}
+
+void TranspositionTable::new_search()
+{
+    m_generation.store((m_generation.load(std::memory_order_relaxed) + 1) & 0xFF, std::memory_order_relaxed);
+}
+
+bool TranspositionTable::probe(uint64_t hash, Entry& entry) const
+{
+    const Slot& slot = m_slots[hash & m_mask];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t key = slot.key.load(std::memory_order_relaxed);
+    if( (key ^ data) != hash || data == 0 ) {
+        return false;
+    }
+    entry.move = static_cast<PackedMove>(data & 0xFFFF);
+    entry.score = static_cast<int16_t>((data >> 16) & 0xFFFF);
+    entry.depth = static_cast<int>((data >> 32) & 0xFF);
+    entry.bound = static_cast<Bound>((data >> 40) & 0xFF);
+    return true;
+}
+
+void TranspositionTable::store(uint64_t hash, PackedMove move, int score, int depth, Bound bound)
+{
+    Slot& slot = m_slots[hash & m_mask];
+    const uint64_t generation = m_generation.load(std::memory_order_relaxed);
+
+    uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+    uint64_t old_key = slot.key.load(std::memory_order_relaxed) ^ old_data;
+    if( old_data != 0 && ((old_data >> 48) & 0xFF) == generation ) {
+        int old_depth = static_cast<int>((old_data >> 32) & 0xFF);
+        // depth-preferred inside one search, but a fresh result of the same position always wins
+        if( old_key != hash && depth < old_depth ) {
+            return;
+        }
+        if( old_key == hash && move == NO_MOVE ) {
+            move = static_cast<PackedMove>(old_data & 0xFFFF);
+        }
+    }
+
+    uint64_t data = static_cast<uint64_t>(move) |
+                    (static_cast<uint64_t>(static_cast<uint16_t>(score)) << 16) |
+                    (static_cast<uint64_t>(std::max(depth, 0) & 0xFF) << 32) |
+                    (static_cast<uint64_t>(bound) << 40) |
+                    (generation << 48);
+    slot.key.store(hash ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+/*
+ *  Searcher implementation
+ */
+
+Searcher::Searcher(TranspositionTable& tt):
+    m_tt(tt), m_nodes(0), m_tt_hits(0), m_aborted(false), m_stopped(false)
+{}
+
+bool Searcher::out_of_budget()
+{
+    if( (m_limits.nodes && m_nodes >= m_limits.nodes) || m_stopped.load(std::memory_order_relaxed) ||
+        (m_limits.time && m_limits.time->hard_limit_reached()) ) {
+        m_aborted = true;
+    }
+    return m_aborted;
+}
+
+bool Searcher::is_repetition(const Position& pos, int ply) const
+{
+    // only the reversible tail of the path can repeat
+    const int first = std::max(0, ply - pos.get_halfmove_clock());
+    for(int i=ply-2; i>=first; i-=2) {
+        if( m_hashes[i] == pos.get_hash() ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Searcher::score_moves(const Position& pos, const PackedMove* moves, int count, int* scores,
+                           PackedMove hash_move, int ply) const
+{
+    for(int i=0; i<count; i++) {
+        const PackedMove move = moves[i];
+        if( move == hash_move ) {
+            scores[i] = 1 << 30;
+        } else if( pos.is_capture(move) ) {
+            scores[i] = (1 << 20) + PIECE_ORDER_VALUES[to_int(pos.get(move & 63))]*16 -
+                        PIECE_ORDER_VALUES[to_int(pos.get(move >> 6))] / 16;
+        } else if( ply < MAX_PLY && (move == m_killers[ply][0] || move == m_killers[ply][1]) ) {
+            scores[i] = (1 << 19) + (move == m_killers[ply][0] ? 1 : 0);
+        } else {
+            scores[i] = 0;
+        }
+    }
+}
+
+SearchResult Searcher::search(const Position& pos, const SearchLimits& limits, const ProgressCallback& progress)
+{
+    PROBE_SCOPE(Probe::SEARCH);
+    m_limits = limits;
+    m_limits.depth = std::min(std::max(limits.depth, 1), MAX_PLY - 1);
+    m_limits.multi_pv = std::max(limits.multi_pv, 1);
+    m_nodes = 0;
+    m_tt_hits = 0;
+    m_aborted = false;
+    const uint64_t pawn_probes = m_pawns.probes(), pawn_hits = m_pawns.hits();
+    memset(m_killers, 0xFF, sizeof(m_killers));
+
+    SearchResult result;
+    result.valid = true;
+    for(int depth=std::min(std::max(limits.start_depth, 1), m_limits.depth); depth<=m_limits.depth; depth++) {
+        // every next line is the best root move except the ones found before,
+        // the table already holds most of the tree, so extra lines are cheap
+        std::vector<PvLine> lines;
+        m_excluded.clear();
+        for(int i=0; i<m_limits.multi_pv; i++) {
+            PvLine line;
+            line.score = alpha_beta(pos, depth, -INFINITE_SCORE, INFINITE_SCORE, 0);
+            if( m_pv_length[0] == 0 || (m_aborted && !lines.empty()) ) {
+                break;
+            }
+            line.pv.assign(m_pv[0], m_pv[0] + m_pv_length[0]);
+            m_excluded.push_back(line.pv[0]);
+            lines.push_back(line);
+            if( m_aborted ) {
+                break;
+            }
+        }
+        m_excluded.clear();
+        // partial iteration is trusted only if nothing was completed yet
+        if( lines.empty() || (m_aborted && result.depth > 0) ) {
+            break;
+        }
+        std::stable_sort(lines.begin(), lines.end(),
+                         [](const PvLine& l1, const PvLine& l2) { return l1.score > l2.score; });
+        result.lines.swap(lines);
+        result.score = result.lines[0].score;
+        result.pv = result.lines[0].pv;
+        result.best_move = result.pv[0];
+        result.depth = m_aborted ? depth-1 : depth;
+        result.nodes = m_nodes;
+        if( m_aborted ) {
+            break;
+        }
+        if( progress ) {
+            progress(result);
+        }
+        if( m_limits.time && !m_limits.time->continue_search(result) ) {
+            break;
+        }
+        bool decided = true;
+        for(auto iter=result.lines.begin(); iter!=result.lines.end(); iter++) {
+            decided = decided && (iter->score > MATE_BOUND || iter->score < -MATE_BOUND);
+        }
+        if( decided ) {
+            break;
+        }
+    }
+    result.nodes = m_nodes;
+    PROBE_COUNT(Probe::SEARCH_NODES, m_nodes);
+    PROBE_COUNT(Probe::TT_HIT, m_tt_hits);
+    PROBE_COUNT(Probe::PAWN_PROBE, m_pawns.probes() - pawn_probes);
+    PROBE_COUNT(Probe::PAWN_HIT, m_pawns.hits() - pawn_hits);
+    UNUSED(pawn_probes, pawn_hits);
+    return result;
+}
+
+int Searcher::alpha_beta(const Position& pos, int depth, int alpha, int beta, int ply)
+{
+    m_pv_length[ply] = 0;
+    if( !pos.has_king(pos.get_side()) ) {
+        return -(MATE_SCORE - ply);
+    }
+    if( depth <= 0 || ply >= MAX_PLY - 1 ) {
+        return quiescence(pos, alpha, beta, ply);
+    }
+    m_nodes++;
+    if( m_nodes % CHECK_INTERVAL == 0 && out_of_budget() ) {
+        return DRAW_SCORE;
+    }
+
+    m_hashes[ply] = pos.get_hash();
+    if( ply > 0 && (pos.get_halfmove_clock() >= FIFTY_MOVES_PLIES || is_repetition(pos, ply)) ) {
+        return DRAW_SCORE;
+    }
+
+    PackedMove hash_move = NO_MOVE;
+    TranspositionTable::Entry entry;
+    if( m_tt.probe(pos.get_hash(), entry) ) {
+        m_tt_hits++;
+        hash_move = entry.move;
+        int score = score_from_tt(entry.score, ply);
+        if( ply > 0 && entry.depth >= depth &&
+            (entry.bound == TranspositionTable::EXACT ||
+             (entry.bound == TranspositionTable::LOWER && score >= beta) ||
+             (entry.bound == TranspositionTable::UPPER && score <= alpha)) )
+        {
+            return score;
+        }
+    }
+
+    PackedMove moves[Position::MAX_MOVES];
+    int scores[Position::MAX_MOVES];
+    const int count = pos.generate_moves(moves);
+    if( count == 0 ) {
+        return DRAW_SCORE;
+    }
+    score_moves(pos, moves, count, scores, hash_move, ply);
+
+    const int original_alpha = alpha;
+    int best_score = -INFINITE_SCORE;
+    PackedMove best_move = NO_MOVE;
+    for(int i=0; i<count; i++) {
+        pick_move(moves, scores, i, count);
+        if( ply == 0 && std::find(m_excluded.begin(), m_excluded.end(), moves[i]) != m_excluded.end() ) {
+            continue;
+        }
+        Position child = pos;
+        child.make_move(moves[i]);
+        int score = -alpha_beta(child, depth-1, -beta, -alpha, ply+1);
+        if( m_aborted ) {
+            return best_move != NO_MOVE ? best_score : DRAW_SCORE;
+        }
+        if( score > best_score ) {
+            best_score = score;
+            best_move = moves[i];
+            if( score > alpha ) {
+                alpha = score;
+                m_pv[ply][0] = moves[i];
+                memcpy(m_pv[ply]+1, m_pv[ply+1], m_pv_length[ply+1]*sizeof(PackedMove));
+                m_pv_length[ply] = m_pv_length[ply+1] + 1;
+            }
+        }
+        if( alpha >= beta ) {
+            if( !pos.is_capture(moves[i]) && m_killers[ply][0] != moves[i] ) {
+                m_killers[ply][1] = m_killers[ply][0];
+                m_killers[ply][0] = moves[i];
+            }
+            break;
+        }
+    }
+
+    // root without some of its moves isn't the real position
+    if( ply == 0 && !m_excluded.empty() ) {
+        return best_score;
+    }
+    TranspositionTable::Bound bound = (best_score >= beta) ? TranspositionTable::LOWER :
+                                      (best_score > original_alpha) ? TranspositionTable::EXACT :
+                                                                      TranspositionTable::UPPER;
+    m_tt.store(pos.get_hash(), best_move, score_to_tt(best_score, ply), depth, bound);
+    return best_score;
+}
+
+int Searcher::quiescence(const Position& pos, int alpha, int beta, int ply)
+{
+    m_pv_length[ply] = 0;
+    if( !pos.has_king(pos.get_side()) ) {
+        return -(MATE_SCORE - ply);
+    }
+    m_nodes++;
+    if( m_nodes % CHECK_INTERVAL == 0 && out_of_budget() ) {
+        return DRAW_SCORE;
+    }
+
+    int best_score = evaluate(pos);
+    if( best_score >= beta || ply >= MAX_PLY - 1 ) {
+        return best_score;
+    }
+    alpha = std::max(alpha, best_score);
+
+    PackedMove moves[Position::MAX_MOVES];
+    int scores[Position::MAX_MOVES];
+    const int count = pos.generate_captures(moves);
+    score_moves(pos, moves, count, scores, NO_MOVE, MAX_PLY);
+
+    for(int i=0; i<count; i++) {
+        pick_move(moves, scores, i, count);
+        Position child = pos;
+        child.make_move(moves[i]);
+        int score = -quiescence(child, -beta, -alpha, ply+1);
+        if( m_aborted ) {
+            return best_score;
+        }
+        if( score > best_score ) {
+            best_score = score;
+            if( score > alpha ) {
+                alpha = score;
+                m_pv[ply][0] = moves[i];
+                memcpy(m_pv[ply]+1, m_pv[ply+1], m_pv_length[ply+1]*sizeof(PackedMove));
+                m_pv_length[ply] = m_pv_length[ply+1] + 1;
+            }
+        }
+        if( alpha >= beta ) {
+            break;
+        }
+    }
+    return best_score;
+}
@@ -0,0 +1,143 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "position.h"
+#include "pawntable.h"
+#include "timemanager.h"
+
+/*
+ *  Alpha-beta search over Position: iterative deepening, transposition table,
+ *  quiescence on captures. Scores are centipawns from side to move point of view,
+ *  losing the king is MATE_SCORE minus plies to it.
+ */
+
+static const int MATE_SCORE = 30000;
+static const int MAX_PLY = 64;
+//scores beyond it are mates
+static const int MATE_BOUND = MATE_SCORE - MAX_PLY;
+
+struct SearchLimits
+{
+    SearchLimits():
+        depth(MAX_PLY), start_depth(1), nodes(0), multi_pv(1), time(NULL)
+    {}
+    int depth;
+    int start_depth;        //first iteration, shallower ones are expected to be in the table already
+    uint64_t nodes;         //0 - no limit
+    int multi_pv;           //number of best root moves to report
+    TimeManager* time;      //clock budget, NULL - none
+};
+
+struct PvLine
+{
+    int score;
+    std::vector<PackedMove> pv;
+};
+
+struct SearchResult
+{
+    SearchResult():
+        valid(false), score(0), depth(0), nodes(0), best_move(NO_MOVE)
+    {}
+    bool valid;             //false for a malformed position
+    int score;
+    int depth;              //last completed iteration
+    uint64_t nodes;
+    PackedMove best_move;
+    std::vector<PackedMove> pv;
+    std::vector<PvLine> lines;      //multi_pv best root moves, best first, lines[0] is score & pv
+};
+
+/*
+ *  TranspositionTable - shared between threads without locks,
+ *  every slot stores key^data so a torn write is seen as a miss
+ */
+
+class TranspositionTable
+{
+public:
+    enum Bound { NONE = 0, UPPER = 1, LOWER = 2, EXACT = 3 };
+
+    struct Entry
+    {
+        PackedMove move;
+        int score;
+        int depth;
+        Bound bound;
+    };
+
+    explicit TranspositionTable(size_t megabytes);
+
+    bool probe(uint64_t hash, Entry& entry) const;
+    void store(uint64_t hash, PackedMove move, int score, int depth, Bound bound);
+    void clear();
+    //ages entries of previous searches so they are replaced first
+    void new_search();
+
+    size_t size() const                                 {   return m_size;   }
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> data;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_size;                  //power of 2
+    uint64_t m_mask;
+    std::atomic<uint32_t> m_generation;
+};
+
+/*
+ *  Searcher - single threaded search, one per worker, many of them can share a table
+ */
+
+class Searcher
+{
+public:
+    //called after every completed iteration
+    typedef std::function<void(const SearchResult& result)> ProgressCallback;
+
+    explicit Searcher(TranspositionTable& tt);
+
+    SearchResult search(const Position& pos, const SearchLimits& limits,
+                        const ProgressCallback& progress = ProgressCallback());
+    //thread safe, ends current search & makes later ones return at once
+    void stop()                                         {   m_stopped.store(true);   }
+    //undoes stop() for a searcher that is reused
+    void resume()                                       {   m_stopped.store(false);   }
+private:
+    int alpha_beta(const Position& pos, int depth, int alpha, int beta, int ply);
+    int quiescence(const Position& pos, int alpha, int beta, int ply);
+
+    //orders moves: hash move, captures by victim/attacker, killers, the rest
+    void score_moves(const Position& pos, const PackedMove* moves, int count, int* scores,
+                     PackedMove hash_move, int ply) const;
+    bool is_repetition(const Position& pos, int ply) const;
+    bool out_of_budget();
+    //static evaluation with pawn structure, side to move point of view
+    int evaluate(const Position& pos)                   {   return pos.evaluate() + m_pawns.evaluate(pos);   }
+
+    TranspositionTable& m_tt;
+    PawnTable m_pawns;
+    SearchLimits m_limits;
+    uint64_t m_nodes;
+    uint64_t m_tt_hits;
+    bool m_aborted;
+    std::atomic<bool> m_stopped;
+    //root moves already reported by previous lines of the current iteration
+    std::vector<PackedMove> m_excluded;
+
+    uint64_t m_hashes[MAX_PLY + 1];             //search path for repetition detection
+    PackedMove m_killers[MAX_PLY][2];
+    PackedMove m_pv[MAX_PLY][MAX_PLY];
+    int m_pv_length[MAX_PLY];
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,179 @@
+#include "tacticminer.h"
+#include "chessboard.h"
+
+#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <cstdlib>
+
+/*
+ *  Auxiliary functions
+ */
+
+//game goes on & the opponent didn't leave the king to be taken
+static bool is_playable(const Position& pos)
+{
+    return pos.has_king(Position::WHITE) && pos.has_king(Position::BLACK) && !pos.can_take_king();
+}
+
+//evaluation change for the side to move after the capture & the best recapture on the same square
+static int capture_gain(const Position& pos, PackedMove capture)
+{
+    Position next(pos);
+    next.make_move(capture);
+    int worst = -next.evaluate();
+
+    PackedMove replies[Position::MAX_MOVES];
+    const int count = next.generate_captures(replies);
+    for(int i=0; i<count; i++) {
+        if( (replies[i] & 63) != (capture & 63) ) {
+            continue;
+        }
+        Position back(next);
+        back.make_move(replies[i]);
+        worst = std::min(worst, back.evaluate());
+    }
+    return worst - pos.evaluate();
+}
+
+static bool is_unique_win(const SearchResult& result)
+{
+    if( !result.valid || result.lines.empty() || result.lines[0].score < TacticMiner::WIN_SCORE ) {
+        return false;
+    }
+    if( result.lines.size() == 1 ) {
+        return true;
+    }
+    const int second = result.lines[1].score;
+    return second < TacticMiner::WIN_SCORE && second <= result.lines[0].score - TacticMiner::UNIQUE_MARGIN;
+}
+
+/*
+ *  TacticMiner implementation
+ */
+
+const int TacticMiner::WIN_SCORE;
+const int TacticMiner::UNIQUE_MARGIN;
+const int TacticMiner::CAPTURE_GAIN;
+const int TacticMiner::SWING_SCORE;
+const int TacticMiner::SWING_PLIES;
+const size_t TacticMiner::SEEN_SLOTS;
+
+TacticMiner::TacticMiner(int threads, size_t hash_mb):
+    m_analyzer(threads, hash_mb), m_seen(SEEN_SLOTS, 0)
+{}
+
+bool TacticMiner::is_candidate(const Position& pos)
+{
+    if( !is_playable(pos) ) {
+        return false;
+    }
+    PackedMove moves[Position::MAX_MOVES];
+    const int count = pos.generate_moves(moves);
+    for(int i=0; i<count; i++) {
+        if( pos.is_capture(moves[i]) && capture_gain(pos, moves[i]) >= CAPTURE_GAIN ) {
+            return true;
+        }
+        // check: the king could be taken if the opponent passed
+        Position next(pos);
+        next.make_move(moves[i]);
+        next.make_null_move();
+        if( next.can_take_king() ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TacticMiner::seen(uint64_t hash)
+{
+    uint64_t& slot = m_seen[hash & (SEEN_SLOTS - 1)];
+    if( slot == hash ) {
+        return true;
+    }
+    slot = hash;
+    return false;
+}
+
+void TacticMiner::collect(const std::string& game, size_t index, std::vector<Candidate>& out,
+                          TacticMinerStats& stats)
+{
+    // malformed tail of a game is ignored, loaded part is mined
+    ChessBoard board;
+    std::istringstream in(game);
+    board.load_game(in);
+    const std::vector<PackedMove> line = board.get_current_line();
+
+    ChessBoard start;
+    start.reset_board();
+    std::vector<Position> positions(1);
+    positions[0].set_board(start);
+    for(auto iter=line.begin(); iter!=line.end() && positions.back().is_legal(*iter); iter++) {
+        positions.push_back(positions.back());
+        positions.back().make_move(*iter);
+    }
+    // white point of view, so evaluations of different plies compare
+    std::vector<int> evals;
+    for(auto iter=positions.begin(); iter!=positions.end(); iter++) {
+        evals.push_back(iter->get_side() == Position::WHITE ? iter->evaluate() : -iter->evaluate());
+    }
+
+    for(size_t ply=0; ply<positions.size(); ply++) {
+        stats.positions++;
+        const Position& pos = positions[ply];
+        const size_t later = std::min(ply + SWING_PLIES, positions.size() - 1);
+        const bool swing = std::abs(evals[later] - evals[ply]) >= SWING_SCORE;
+        if( !(swing ? is_playable(pos) : is_candidate(pos)) || seen(pos.get_hash()) ) {
+            continue;
+        }
+        Candidate candidate = { pos.get_fen(), index, static_cast<int>(ply) };
+        out.push_back(candidate);
+    }
+}
+
+TacticMinerStats TacticMiner::mine(std::istream& games, int depth, const PuzzleCallback& callback)
+{
+    TacticMinerStats stats = { 0, 0, 0, 0 };
+    std::fill(m_seen.begin(), m_seen.end(), 0);
+
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.multi_pv = 2;
+
+    // candidates of the game being read & the ones handed to the analyzer, in order
+    std::vector<Candidate> game;
+    size_t next = 0;
+    std::deque<Candidate> in_flight;
+    size_t line_index = 0;
+    std::string line;
+
+    m_analyzer.analyze([&](std::string& fen) {
+        while( next == game.size() ) {
+            if( !std::getline(games, line) ) {
+                return false;
+            }
+            const size_t index = line_index++;
+            if( line.find_first_not_of(" \t\r") == std::string::npos ) {
+                continue;
+            }
+            stats.games++;
+            game.clear();
+            next = 0;
+            collect(line, index, game, stats);
+        }
+        fen = game[next].fen;
+        in_flight.push_back(std::move(game[next++]));
+        stats.candidates++;
+        return true;
+    }, limits, [&](size_t, const std::string&, const SearchResult& result) {
+        Candidate candidate = std::move(in_flight.front());
+        in_flight.pop_front();
+        if( !is_unique_win(result) ) {
+            return;
+        }
+        Puzzle puzzle = { candidate.fen, candidate.game, candidate.ply, result.lines[0].score, result.lines[0].pv };
+        stats.puzzles++;
+        callback(puzzle);
+    });
+    return stats;
+}
@@ -0,0 +1,80 @@
+#ifndef TACTICMINER_H
+#define TACTICMINER_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <functional>
+#include <cstdint>
+
+#include "batchanalyzer.h"
+#include "position.h"
+
+/*
+ *  TacticMiner - puzzles out of game archives (one game per line, ChessBoard::save_game format).
+ *
+ *  Every position of every main line goes through a cheap filter on the reading thread:
+ *  a check, a capture winning material after the best recapture, or a material swing a few plies
+ *  later in the game. Survivors are searched in parallel by BatchAnalyzer with two lines,
+ *  a puzzle is a position with exactly one winning move. Reading stops while the searches
+ *  are behind, so memory is bounded by the window of BatchAnalyzer & the longest game.
+ */
+
+struct Puzzle
+{
+    std::string fen;
+    size_t game;                //line of the archive, from 0
+    int ply;
+    int score;                  //side to move point of view
+    std::vector<PackedMove> solution;
+};
+
+struct TacticMinerStats
+{
+    size_t games;
+    uint64_t positions;
+    uint64_t candidates;        //passed the filter & searched
+    uint64_t puzzles;
+};
+
+class TacticMiner
+{
+public:
+    //called in archive order
+    typedef std::function<void(const Puzzle& puzzle)> PuzzleCallback;
+
+    //winning move scores at least WIN_SCORE, every other one less than that & UNIQUE_MARGIN below the best
+    static const int WIN_SCORE = 300;
+    static const int UNIQUE_MARGIN = 200;
+    //filter thresholds: material won by a capture, evaluation change within SWING_PLIES of the game
+    static const int CAPTURE_GAIN = 150;
+    static const int SWING_SCORE = 200;
+    static const int SWING_PLIES = 4;
+    //positions seen recently are skipped, lossy & fixed size
+    static const size_t SEEN_SLOTS = 1 << 16;
+
+    TacticMiner(int threads, size_t hash_mb);
+
+    TacticMinerStats mine(std::istream& games, int depth, const PuzzleCallback& callback);
+
+    //cheap part: threats & captures of the side to move
+    static bool is_candidate(const Position& pos);
+
+    int threads_count() const                           {   return m_analyzer.threads_count();   }
+private:
+    struct Candidate
+    {
+        std::string fen;
+        size_t game;
+        int ply;
+    };
+
+    //filters main line positions of a game into candidates
+    void collect(const std::string& game, size_t index, std::vector<Candidate>& out, TacticMinerStats& stats);
+    bool seen(uint64_t hash);
+
+    BatchAnalyzer m_analyzer;
+    std::vector<uint64_t> m_seen;
+};
+
+#endif // TACTICMINER_H
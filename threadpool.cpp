@@ -0,0 +1,114 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+static thread_local int t_worker_index = -1;
+static thread_local const ThreadPool* t_pool = NULL;
+
+/*
+ *  ThreadPool implementation
+ */
+
+ThreadPool::ThreadPool(int threads):
+    m_queued(0), m_pending(0), m_next_worker(0), m_stop(false)
+{
+    threads = std::max(threads, 1);
+    for(int i=0; i<threads; i++) {
+        m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for(int i=0; i<threads; i++) {
+        m_workers[i]->thread = std::thread(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for(auto iter=m_workers.begin(); iter!=m_workers.end(); iter++) {
+        (*iter)->thread.join();
+    }
+}
+
+int ThreadPool::worker_index()
+{
+    return t_worker_index;
+}
+
+void ThreadPool::submit(Task task)
+{
+    // workers keep their own subtasks local, so they are taken first & hot in cache
+    const bool local = (t_pool == this);
+    size_t ind = local ? static_cast<size_t>(t_worker_index) : 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending++;
+        // counted before it's visible, so the counter never goes below the real number of tasks
+        m_queued++;
+        if( !local ) {
+            ind = m_next_worker++ % m_workers.size();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_workers[ind]->mutex);
+        m_workers[ind]->tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this]() { return m_pending == 0; });
+}
+
+bool ThreadPool::pop(int ind, Task& task)
+{
+    {
+        Worker& own = *m_workers[ind];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if( !own.tasks.empty() ) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            m_queued--;
+            return true;
+        }
+    }
+    const int count = threads_count();
+    for(int i=1; i<count; i++) {
+        Worker& victim = *m_workers[(ind + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if( !victim.tasks.empty() ) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(int ind)
+{
+    t_worker_index = ind;
+    t_pool = this;
+    while( true ) {
+        Task task;
+        if( pop(ind, task) ) {
+            task();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if( --m_pending == 0 ) {
+                m_done.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this]() { return m_queued > 0 || m_stop; });
+        if( m_stop && m_queued == 0 ) {
+            return;
+        }
+    }
+}
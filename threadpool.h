@@ -0,0 +1,58 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/*
+ *  ThreadPool - fixed set of workers with a task deque each.
+ *  Owner takes the newest task of its deque, idle workers steal the oldest ones
+ *  from the others. Tasks submitted from outside are spread round-robin.
+ */
+
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit ThreadPool(int threads);
+    //runs all queued tasks before joining
+    ~ThreadPool();
+
+    int threads_count() const                   {   return static_cast<int>(m_workers.size());   }
+
+    void submit(Task task);
+    //blocks until every submitted task has finished
+    void wait();
+
+    //index of the calling worker in its pool, -1 for threads outside of any pool
+    static int worker_index();
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void run(int ind);
+    bool pop(int ind, Task& task);
+
+    std::vector<std::unique_ptr<Worker> > m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::atomic<size_t> m_queued;
+    size_t m_pending;               //queued or running, guarded by m_mutex
+    size_t m_next_worker;
+    bool m_stop;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,133 @@
+#include "timemanager.h"
+#include "search.h"
+
+#include <algorithm>
+
+/*
+ *  Auxiliary functions
+ */
+
+//iterations with the same best move before the budget is cut
+static const int STABLE_ITERATIONS = 4;
+static const int STABLE_SCALE_PERCENT = 60;
+static const int UNSTABLE_SCALE_PERCENT = 140;
+//score falls between iterations & extra budget for them
+static const int SMALL_DROP = 25;
+static const int LARGE_DROP = 60;
+static const int SMALL_DROP_EXTRA_PERCENT = 40;
+static const int LARGE_DROP_EXTRA_PERCENT = 80;
+
+/*
+ *  TimeManager implementation
+ */
+
+const int TimeManager::EXPECTED_MOVES;
+const int64_t TimeManager::MOVE_OVERHEAD_MS;
+const int TimeManager::MAXIMUM_OPTIMUMS;
+const int TimeManager::MAXIMUM_PERCENT;
+
+TimeManager::TimeManager():
+    m_search_start(now_ms()), m_clock_start(now_ms()), m_optimum_ms(-1), m_maximum_ms(-1), m_scale_percent(100),
+    m_unchecked_iteration(false), m_best_move(NO_MOVE), m_stable_iterations(0), m_last_score(0)
+{}
+
+int64_t TimeManager::now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+}
+
+void TimeManager::reset()
+{
+    m_optimum_ms.store(-1);
+    m_maximum_ms.store(-1);
+    m_scale_percent.store(100);
+    m_unchecked_iteration.store(false);
+    m_search_start.store(now_ms());
+    m_best_move = NO_MOVE;
+    m_stable_iterations = 0;
+    m_last_score = 0;
+}
+
+void TimeManager::start(const TimeControl& control)
+{
+    const int64_t available = std::max<int64_t>(control.remaining_ms - MOVE_OVERHEAD_MS, 1);
+    const int moves = (control.moves_to_go > 0) ? std::min(control.moves_to_go, EXPECTED_MOVES) : EXPECTED_MOVES;
+    int64_t maximum = available * MAXIMUM_PERCENT / 100;
+    if( control.moves_to_go == 1 ) {
+        // the last move before the control may take all of it
+        maximum = available;
+    }
+    int64_t optimum = available / moves + control.increment_ms * 3 / 4;
+    maximum = std::max<int64_t>(std::min(maximum, optimum * MAXIMUM_OPTIMUMS), 1);
+    optimum = std::max<int64_t>(std::min(optimum, maximum), 1);
+
+    // maximum first: the search thread may see the new optimum before it
+    m_clock_start.store(now_ms());
+    m_maximum_ms.store(maximum);
+    m_optimum_ms.store(optimum);
+    m_unchecked_iteration.store(true);
+}
+
+int64_t TimeManager::elapsed_ms() const
+{
+    return now_ms() - m_search_start.load();
+}
+
+bool TimeManager::hard_limit_reached() const
+{
+    const int64_t maximum = m_maximum_ms.load(std::memory_order_relaxed);
+    if( maximum < 0 ) {
+        return false;
+    }
+    return now_ms() - m_clock_start.load(std::memory_order_relaxed) >= maximum ||
+           (m_unchecked_iteration.load(std::memory_order_relaxed) && optimum_spent());
+}
+
+bool TimeManager::optimum_spent() const
+{
+    const int64_t optimum = m_optimum_ms.load();
+    if( optimum < 0 ) {
+        return false;
+    }
+    // time spent before start() (pondering) counts here, not against the hard limit
+    const int64_t budget = std::min(optimum * m_scale_percent.load() / 100, m_maximum_ms.load());
+    return elapsed_ms() >= budget;
+}
+
+bool TimeManager::continue_search(const SearchResult& result)
+{
+    if( result.depth == 0 ) {
+        return true;
+    }
+    const bool first = (m_best_move == NO_MOVE);
+    if( result.best_move == m_best_move ) {
+        m_stable_iterations++;
+    } else {
+        m_best_move = result.best_move;
+        m_stable_iterations = 0;
+    }
+
+    int scale = 100;
+    if( m_stable_iterations >= STABLE_ITERATIONS ) {
+        scale = STABLE_SCALE_PERCENT;
+    } else if( m_stable_iterations == 0 && !first ) {
+        scale = UNSTABLE_SCALE_PERCENT;
+    }
+    const int drop = first ? 0 : m_last_score - result.score;
+    if( drop >= LARGE_DROP ) {
+        scale += LARGE_DROP_EXTRA_PERCENT;
+    } else if( drop >= SMALL_DROP ) {
+        scale += SMALL_DROP_EXTRA_PERCENT;
+    }
+    m_last_score = result.score;
+    m_scale_percent.store(scale);
+    m_unchecked_iteration.store(false);
+
+    const int64_t optimum = m_optimum_ms.load();
+    if( optimum < 0 ) {
+        return true;
+    }
+    // the next iteration takes about as long as all the previous ones
+    const int64_t budget = std::min(optimum * scale / 100, m_maximum_ms.load());
+    return elapsed_ms() * 2 < budget;
+}
@@ -0,0 +1,82 @@
+#ifndef TIMEMANAGER_H
+#define TIMEMANAGER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "chesspiecemove.h"
+
+struct SearchResult;
+
+/*
+ *  Time management for searches on a clock.
+ *
+ *  A move gets an optimum share of the remaining time (by moves to go, or an expected game
+ *  length in sudden death) plus most of the increment, and a hard maximum that is never crossed.
+ *  After every iteration the optimum is scaled: a best move that holds for several iterations
+ *  cuts it, a changed best move or a falling score extends it. Another iteration is started
+ *  only if it is likely to end within the scaled optimum. An iteration that began before
+ *  the clock started (pondering) had no such check, it is cut at the scaled optimum.
+ */
+
+struct TimeControl
+{
+    TimeControl():
+        remaining_ms(0), increment_ms(0), moves_to_go(0)
+    {}
+    int64_t remaining_ms;
+    int64_t increment_ms;
+    int moves_to_go;            //moves until the next time control, 0 - rest of the game
+};
+
+class TimeManager
+{
+public:
+    //moves expected to be left when there is no moves to go
+    static const int EXPECTED_MOVES = 30;
+    //kept on the clock for move transfer & the GUI
+    static const int64_t MOVE_OVERHEAD_MS = 50;
+    //hard limit in optimums & share of the remaining time
+    static const int MAXIMUM_OPTIMUMS = 5;
+    static const int MAXIMUM_PERCENT = 40;
+
+    TimeManager();
+
+    //new search without a budget, searches on until start(), called before the search begins
+    void reset();
+    //budget of the side to move, its clock runs from now on
+    //thread safe, the search may be running already (pondering)
+    void start(const TimeControl& control);
+
+    //checked during the search
+    bool hard_limit_reached() const;
+    //after every completed iteration, updates stability, @ret false to stop before the next one
+    bool continue_search(const SearchResult& result);
+    //search time (from reset()) is over the scaled optimum, thread safe
+    bool optimum_spent() const;
+
+    bool is_limited() const                             {   return m_optimum_ms.load() >= 0;   }
+    //from reset()
+    int64_t elapsed_ms() const;
+    int64_t optimum_ms() const                          {   return m_optimum_ms.load();   }
+    int64_t maximum_ms() const                          {   return m_maximum_ms.load();   }
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static int64_t now_ms();
+
+    std::atomic<int64_t> m_search_start;
+    std::atomic<int64_t> m_clock_start;
+    std::atomic<int64_t> m_optimum_ms;          //-1 - no limit
+    std::atomic<int64_t> m_maximum_ms;
+    std::atomic<int> m_scale_percent;
+    std::atomic<bool> m_unchecked_iteration;    //current iteration began without a budget
+
+    //search thread only
+    PackedMove m_best_move;
+    int m_stable_iterations;
+    int m_last_score;
+};
+
+#endif // TIMEMANAGER_H
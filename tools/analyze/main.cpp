@@ -0,0 +1,154 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+#include "batchanalyzer.h"
+#include "analysiscache.h"
+#include "chessboard.h"
+
+/*
+ *  analyze [fen file] [--depth N] [--nodes N] [--threads N] [--hash MB] [--cache file | --no-cache] [--scaling]
+ *
+ *  Searches every FEN of the file (stdin if omitted) and prints
+ *  "fen <tab> score <tab> depth <tab> nodes <tab> pv" in input order, throughput goes to stderr.
+ *  Results go to the analysis cache shared with the GUI (AnalysisCache::default_path() unless --cache),
+ *  positions already searched deep enough are answered from it.
+ *  --scaling runs the whole set with 1, 2, 4 .. threads and prints speedup per core instead, without the cache.
+ */
+
+static int usage()
+{
+    std::cerr << "usage: analyze [fen file] [--depth N] [--nodes N] [--threads N] [--hash MB] [--cache file | --no-cache] [--scaling]" << std::endl;
+    return 1;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int run_scaling(std::istream& in, const SearchLimits& limits, int max_threads, size_t hash_mb)
+{
+    std::vector<std::string> fens;
+    std::string line;
+    while( std::getline(in, line) ) {
+        if( line.find_first_not_of(" \t\r") != std::string::npos ) {
+            fens.push_back(line);
+        }
+    }
+    if( fens.empty() ) {
+        std::cerr << "no positions" << std::endl;
+        return 1;
+    }
+
+    std::vector<int> counts;
+    for(int t=1; t<max_threads; t*=2) {
+        counts.push_back(t);
+    }
+    counts.push_back(max_threads);
+
+    double base = 0;
+    std::cout << "threads\tpos/s\tnodes/s\tspeedup\tper core" << std::endl;
+    for(size_t i=0; i<counts.size(); i++) {
+        // fresh table every run, otherwise later runs just replay hash hits
+        BatchAnalyzer analyzer(counts[i], hash_mb);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<SearchResult> results = analyzer.analyze(fens, limits);
+        double secs = seconds_since(start);
+
+        uint64_t nodes = 0;
+        for(auto iter=results.begin(); iter!=results.end(); iter++) {
+            nodes += iter->nodes;
+        }
+        double rate = fens.size() / secs;
+        if( i == 0 ) {
+            base = rate;
+        }
+        std::cout << counts[i] << "\t" << rate << "\t" << nodes / secs << "\t" << rate / base
+                  << "\t" << rate / base / counts[i] << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    SearchLimits limits;
+    limits.depth = 6;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    size_t hash_mb = 64;
+    bool scaling = false;
+    std::string file;
+    std::string cache_file = AnalysisCache::default_path();
+
+    for(int i=1; i<argc; i++) {
+        bool has_value = i+1 < argc;
+        if( !strcmp(argv[i], "--depth") && has_value ) {
+            limits.depth = std::atoi(argv[++i]);
+        } else if( !strcmp(argv[i], "--nodes") && has_value ) {
+            limits.nodes = std::strtoull(argv[++i], NULL, 10);
+        } else if( !strcmp(argv[i], "--threads") && has_value ) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if( !strcmp(argv[i], "--hash") && has_value ) {
+            hash_mb = std::strtoul(argv[++i], NULL, 10);
+        } else if( !strcmp(argv[i], "--cache") && has_value ) {
+            cache_file = argv[++i];
+        } else if( !strcmp(argv[i], "--no-cache") ) {
+            cache_file.clear();
+        } else if( !strcmp(argv[i], "--scaling") ) {
+            scaling = true;
+        } else if( argv[i][0] != '-' && file.empty() ) {
+            file = argv[i];
+        } else {
+            return usage();
+        }
+    }
+
+    std::ifstream in_file;
+    if( !file.empty() ) {
+        in_file.open(file.c_str());
+        if( !in_file ) {
+            std::cerr << "can't open " << file << std::endl;
+            return 2;
+        }
+    }
+    std::istream& in = file.empty() ? std::cin : in_file;
+
+    if( scaling ) {
+        return run_scaling(in, limits, threads, hash_mb);
+    }
+
+    BatchAnalyzer analyzer(threads, hash_mb);
+    if( !cache_file.empty() ) {
+        std::shared_ptr<AnalysisCache> cache(new AnalysisCache());
+        if( cache->open(cache_file) ) {
+            analyzer.set_cache(cache);
+        } else {
+            std::cerr << "can't open analysis cache " << cache_file << ", running without it" << std::endl;
+        }
+    }
+    uint64_t nodes = 0;
+    size_t invalid = 0;
+    auto start = std::chrono::steady_clock::now();
+    size_t count = analyzer.analyze(in, limits, [&](size_t, const std::string& fen, const SearchResult& result) {
+        if( !result.valid ) {
+            invalid++;
+            std::cout << fen << "\tinvalid" << std::endl;
+            return;
+        }
+        nodes += result.nodes;
+        std::cout << fen << "\t" << result.score << "\t" << result.depth << "\t" << result.nodes
+                  << "\t" << ChessBoard::moves_to_string(result.pv) << "\n";
+    });
+    std::cout.flush();
+    double secs = seconds_since(start);
+
+    std::cerr << count << " positions (" << invalid << " invalid), " << secs << " s, "
+              << count / secs << " pos/s, " << nodes / secs << " nodes/s, "
+              << analyzer.threads_count() << " threads, " << analyzer.cache_hits() << " from cache" << std::endl;
+    return invalid ? 3 : 0;
+}
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "cluster.h"
+#include "chessboard.h"
+
+/*
+ *  cluster worker <address> [--hash MB]
+ *  cluster perft|analyze <fen> --depth N (--workers addr,addr,.. | --spawn N) [--timeout S]
+ *
+ *  Address is "unix:<path>" or "<host>:<port>", listing an address twice opens two connections to it.
+ *  --spawn starts N local workers on unix sockets for the run.
+ *  perft prints leaves under every root move, analyze prints every root move with its score & pv,
+ *  both finish with aggregate nodes per second & per worker statistics.
+ */
+
+static const char START_FEN[] = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static int usage()
+{
+    std::cerr << "usage: cluster worker <address> [--hash MB]\n"
+              << "       cluster perft|analyze <fen|startpos> --depth N (--workers addr,addr,.. | --spawn N) [--timeout S]"
+              << std::endl;
+    return 1;
+}
+
+static std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> res;
+    std::istringstream in(list);
+    std::string item;
+    while( std::getline(in, item, ',') ) {
+        if( !item.empty() ) {
+            res.push_back(item);
+        }
+    }
+    return res;
+}
+
+//forks workers listening on unix sockets, @ret their addresses
+static std::vector<std::string> spawn_workers(int count, std::vector<pid_t>& pids)
+{
+    std::vector<std::string> addresses;
+    for(int i=0; i<count; i++) {
+        const std::string address = "unix:/tmp/chess-cluster-" + std::to_string(getpid()) + "-" + std::to_string(i);
+        pid_t pid = fork();
+        if( pid == 0 ) {
+            ClusterWorker worker(16);
+            worker.run(address);
+            _exit(1);
+        }
+        if( pid < 0 ) {
+            break;
+        }
+        pids.push_back(pid);
+        addresses.push_back(address);
+    }
+    // workers are ready once they accept connections
+    for(auto iter=addresses.begin(); iter!=addresses.end(); iter++) {
+        for(int attempt=0; attempt<100; attempt++) {
+            LineChannel probe(LineChannel::connect_to(*iter));
+            if( probe.is_open() ) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    return addresses;
+}
+
+static void stop_workers(const std::vector<pid_t>& pids, const std::vector<std::string>& addresses)
+{
+    for(auto iter=pids.begin(); iter!=pids.end(); iter++) {
+        kill(*iter, SIGTERM);
+        waitpid(*iter, NULL, 0);
+    }
+    for(auto iter=addresses.begin(); iter!=addresses.end(); iter++) {
+        unlink(iter->substr(strlen("unix:")).c_str());
+    }
+}
+
+static void print_stats(const ClusterCoordinator& coordinator)
+{
+    const double secs = coordinator.elapsed_seconds();
+    std::cout << "nodes " << coordinator.nodes() << ", " << secs << " s, "
+              << (secs > 0 ? coordinator.nodes() / secs : 0) << " nodes/s" << std::endl;
+    const std::vector<ClusterWorkerStats>& stats = coordinator.worker_stats();
+    for(auto iter=stats.begin(); iter!=stats.end(); iter++) {
+        std::cout << "  " << iter->address << ": " << iter->tasks << " tasks, " << iter->nodes << " nodes"
+                  << (iter->failed ? ", failed" : "") << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if( argc < 3 ) {
+        return usage();
+    }
+    const std::string cmd = argv[1];
+
+    if( cmd == "worker" ) {
+        size_t hash_mb = 64;
+        for(int i=3; i<argc; i++) {
+            if( !strcmp(argv[i], "--hash") && i+1 < argc ) {
+                hash_mb = std::strtoul(argv[++i], NULL, 10);
+            } else {
+                return usage();
+            }
+        }
+        ClusterWorker worker(hash_mb);
+        worker.run(argv[2]);
+        std::cerr << "can't listen on " << argv[2] << std::endl;
+        return 2;
+    }
+    if( cmd != "perft" && cmd != "analyze" ) {
+        return usage();
+    }
+
+    const std::string fen = strcmp(argv[2], "startpos") ? argv[2] : START_FEN;
+    int depth = 0, spawn = 0, timeout = 0;
+    std::vector<std::string> workers;
+    for(int i=3; i<argc; i++) {
+        bool has_value = i+1 < argc;
+        if( !strcmp(argv[i], "--depth") && has_value ) {
+            depth = std::atoi(argv[++i]);
+        } else if( !strcmp(argv[i], "--workers") && has_value ) {
+            workers = split(argv[++i]);
+        } else if( !strcmp(argv[i], "--spawn") && has_value ) {
+            spawn = std::atoi(argv[++i]);
+        } else if( !strcmp(argv[i], "--timeout") && has_value ) {
+            timeout = std::atoi(argv[++i]);
+        } else {
+            return usage();
+        }
+    }
+    Position pos;
+    if( depth <= 0 || !pos.set_fen(fen) ) {
+        return usage();
+    }
+
+    std::vector<pid_t> pids;
+    std::vector<std::string> spawned;
+    if( spawn > 0 ) {
+        spawned = spawn_workers(spawn, pids);
+        workers.insert(workers.end(), spawned.begin(), spawned.end());
+    }
+    if( workers.empty() ) {
+        return usage();
+    }
+
+    ClusterCoordinator coordinator(workers, timeout);
+    bool ok;
+    if( cmd == "perft" ) {
+        PerftResult result;
+        ok = coordinator.perft(pos, depth, result);
+        if( ok ) {
+            for(auto iter=result.divide.begin(); iter!=result.divide.end(); iter++) {
+                std::cout << ChessBoard::moves_to_string(std::vector<PackedMove>(1, iter->first)) << "\t"
+                          << iter->second << "\n";
+            }
+            std::cout << "perft " << depth << ": " << result.nodes << std::endl;
+        }
+    } else {
+        SearchResult result;
+        ok = coordinator.analyze(pos, depth, result);
+        if( ok ) {
+            for(auto iter=result.lines.begin(); iter!=result.lines.end(); iter++) {
+                std::cout << iter->score << "\t" << ChessBoard::moves_to_string(iter->pv) << "\n";
+            }
+            std::cout << "depth " << result.depth << ", best " << ChessBoard::moves_to_string(result.pv) << std::endl;
+        }
+    }
+    if( !ok ) {
+        std::cerr << "failed: no worker left or a bad reply" << std::endl;
+    }
+    print_stats(coordinator);
+
+    stop_workers(pids, spawned);
+    return ok ? 0 : 3;
+}
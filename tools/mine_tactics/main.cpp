@@ -0,0 +1,73 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+
+#include "tacticminer.h"
+#include "chessboard.h"
+
+/*
+ *  mine_tactics [games file] [--depth N] [--threads N] [--hash MB]
+ *
+ *  Reads an archive with one saved game per line (stdin if omitted) and prints
+ *  "fen <tab> solution <tab> score <tab> game <tab> ply" for every puzzle found,
+ *  game is the line of the archive from 0. Counts & throughput go to stderr.
+ */
+
+static int usage()
+{
+    std::cerr << "usage: mine_tactics [games file] [--depth N] [--threads N] [--hash MB]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int depth = 6;
+    int threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    size_t hash_mb = 64;
+    std::string file;
+
+    for(int i=1; i<argc; i++) {
+        bool has_value = i+1 < argc;
+        if( !strcmp(argv[i], "--depth") && has_value ) {
+            depth = std::atoi(argv[++i]);
+        } else if( !strcmp(argv[i], "--threads") && has_value ) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if( !strcmp(argv[i], "--hash") && has_value ) {
+            hash_mb = std::strtoul(argv[++i], NULL, 10);
+        } else if( argv[i][0] != '-' && file.empty() ) {
+            file = argv[i];
+        } else {
+            return usage();
+        }
+    }
+
+    std::ifstream in_file;
+    if( !file.empty() ) {
+        in_file.open(file.c_str());
+        if( !in_file ) {
+            std::cerr << "can't open " << file << std::endl;
+            return 2;
+        }
+    }
+    std::istream& in = file.empty() ? std::cin : in_file;
+
+    TacticMiner miner(threads, hash_mb);
+    auto start = std::chrono::steady_clock::now();
+    TacticMinerStats stats = miner.mine(in, depth, [](const Puzzle& puzzle) {
+        std::cout << puzzle.fen << "\t" << ChessBoard::moves_to_string(puzzle.solution) << "\t" << puzzle.score
+                  << "\t" << puzzle.game << "\t" << puzzle.ply << "\n";
+    });
+    std::cout.flush();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cerr << stats.games << " games, " << stats.positions << " positions, " << stats.candidates
+              << " searched, " << stats.puzzles << " puzzles, " << secs << " s, "
+              << stats.positions / secs << " positions/s, " << stats.candidates / secs << " searches/s, "
+              << miner.threads_count() << " threads" << std::endl;
+    return 0;
+}
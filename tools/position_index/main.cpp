@@ -0,0 +1,79 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+
+#include "positionindex.h"
+#include "chessboard.h"
+
+/*
+ *  position_index build|append <games file> <index> [threads]
+ *  position_index query <index> ["[e2,e4] [e7,e5] ..."]
+ */
+
+static int usage()
+{
+    std::cerr << "usage: position_index build|append <games file> <index> [threads]\n"
+              << "       position_index query <index> [moves]" << std::endl;
+    return 1;
+}
+
+static std::string move_to_string(PackedMove move)
+{
+    std::ostringstream out;
+    ChessBoard::write_move(out, unpacked_src(move), unpacked_dst(move));
+    return out.str();
+}
+
+int main(int argc, char *argv[])
+{
+    if( argc < 3 ) {
+        return usage();
+    }
+    std::string cmd = argv[1];
+    auto start = std::chrono::steady_clock::now();
+
+    if( cmd == "build" || cmd == "append" ) {
+        if( argc < 4 ) {
+            return usage();
+        }
+        int threads = (argc > 4) ? std::atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+        bool ok = (cmd == "build") ? PositionIndex::build(argv[2], argv[3], threads)
+                                   : PositionIndex::append(argv[2], argv[3], threads);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if( !ok ) {
+            std::cerr << "failed to " << cmd << " index " << argv[3] << std::endl;
+            return 2;
+        }
+        PositionIndex index;
+        index.open(argv[3]);
+        std::cout << index.games_count() << " games indexed, " << secs << " s" << std::endl;
+        return 0;
+    }
+
+    if( cmd == "query" ) {
+        PositionIndex index;
+        if( !index.open(argv[2]) ) {
+            std::cerr << "can't open index " << argv[2] << std::endl;
+            return 2;
+        }
+        ChessBoard board;
+        std::istringstream moves(argc > 3 ? argv[3] : "");
+        if( !board.load_game(moves) ) {
+            std::cerr << "bad moves" << std::endl;
+            return 1;
+        }
+        start = std::chrono::steady_clock::now();
+        PositionStats stats = index.query(board.get_hash());
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << stats.occurrences << " occurrences in " << stats.games << " games (" << ms << " ms)" << std::endl;
+        for(auto iter=stats.moves.begin(); iter!=stats.moves.end(); iter++) {
+            std::cout << move_to_string(iter->move) << "\t" << iter->count << std::endl;
+        }
+        return 0;
+    }
+    return usage();
+}
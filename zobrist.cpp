@@ -0,0 +1,36 @@
+#include "zobrist.h"
+
+/*
+ *  splitmix64 with a fixed seed - keys must be stable between runs
+ *  because hashes are written to disk
+ */
+static uint64_t next_key(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+Zobrist::Zobrist()
+{
+    uint64_t state = 0x43484553535A4F42ULL;
+    for(int cp=0; cp<PIECES; cp++) {
+        for(int r=0; r<8; r++) {
+            for(int c=0; c<8; c++) {
+                // empty square does not change the hash
+                m_pieces[cp][r][c] = (cp == 0) ? 0 : next_key(state);
+            }
+        }
+    }
+    for(int i=0; i<CASTLING_SQUARES; i++) {
+        m_castling[i] = next_key(state);
+    }
+    m_side = next_key(state);
+}
+
+const Zobrist& Zobrist::keys()
+{
+    static const Zobrist instance;
+    return instance;
+}
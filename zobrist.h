@@ -0,0 +1,45 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+/*
+ *  Zobrist keys shared by everything that hashes a position
+ *  (ChessBoard history, indexes, caches), so hashes are comparable between them.
+ */
+
+class Zobrist
+{
+public:
+    static const int PIECES = 13;
+    //squares whose "first move" flag decides castling: a1, e1, h1, a8, e8, h8
+    static const int CASTLING_SQUARES = 6;
+
+    static uint64_t piece(int cp, int r, int c)     {   return keys().m_pieces[cp][r][c];   }
+    static uint64_t castling(int ind)               {   return keys().m_castling[ind];    }
+    static uint64_t black_to_move()                 {   return keys().m_side;    }
+
+    //@ret index of castling square or -1
+    static int castling_square(int r, int c)
+    {
+        if( r != 0 && r != 7 ) {
+            return -1;
+        }
+        int base = (r == 0) ? 0 : 3;
+        switch(c) {
+            case 0: return base;
+            case 4: return base+1;
+            case 7: return base+2;
+            default: return -1;
+        }
+    }
+private:
+    Zobrist();
+    static const Zobrist& keys();
+
+    uint64_t m_pieces[PIECES][8][8];
+    uint64_t m_castling[CASTLING_SQUARES];
+    uint64_t m_side;
+};
+
+#endif // ZOBRIST_H